@@ -8,6 +8,64 @@ static s32 ixgbe_poll_for_msg(struct ixgbe_hw *hw, u16 mbx_id);
 static s32 ixgbe_poll_for_ack(struct ixgbe_hw *hw, u16 mbx_id);
 static void ixgbe_mbx_reset_timeout(struct ixgbe_hw *hw);
 
+/**
+ * ixgbe_mbx_delay - wait one polling interval
+ * @hw: pointer to the HW structure
+ *
+ * Sleeps through the wait hook if the OS layer provided one, otherwise
+ * busy-waits for mbx->udelay microseconds.
+ **/
+static void ixgbe_mbx_delay(struct ixgbe_hw *hw)
+{
+	struct ixgbe_mbx_info *mbx = &hw->mbx;
+
+	if (mbx->wait)
+		mbx->wait(hw, mbx->udelay);
+	else
+		udelay(mbx->udelay);
+}
+
+/**
+ * ixgbe_mbx_account - charge a finished exchange to its request opcode
+ * @hw: pointer to the HW structure
+ * @msg: reply, NULL when the exchange failed
+ * @ret_val: result of the write or poll
+ *
+ * The first reply after ixgbe_write_mbx() closes the request, so a PF
+ * message read later is not mistaken for a slow answer.
+ **/
+static void ixgbe_mbx_account(struct ixgbe_hw *hw, u32 *msg, s32 ret_val)
+{
+	struct ixgbe_mbx_info *mbx = &hw->mbx;
+	struct ixgbe_mbx_op_stats *op;
+	u64 usecs;
+
+	if (mbx->req_opcode >= IXGBE_MBX_STATS_OPCODES)
+		return;
+
+	op = &mbx->stats.op[mbx->req_opcode];
+	mbx->req_opcode = IXGBE_MBX_STATS_OPCODES;
+
+	if (ret_val) {
+		if (ret_val == IXGBE_ERR_TIMEOUT) {
+			op->timeouts++;
+			mbx->stats.timeouts++;
+		}
+		return;
+	}
+
+	if (msg[0] & IXGBE_VT_MSGTYPE_FAILURE) {
+		op->nacks++;
+		mbx->stats.nacks++;
+	}
+
+	usecs = div_u64(ktime_get_ns() - mbx->req_start_ns, NSEC_PER_USEC);
+	op->latency[min_t(u32, fls64(usecs), IXGBE_MBX_STATS_BUCKETS - 1)]++;
+	op->total_us += usecs;
+	if (usecs > op->max_us)
+		op->max_us = min_t(u64, usecs, U32_MAX);
+}
+
 /**
  * ixgbe_read_mbx - Reads a message from the mailbox
  * @hw: pointer to the HW structure
@@ -67,9 +125,12 @@ s32 ixgbe_poll_mbx(struct ixgbe_hw *hw, u32 *msg, u16 size, u16 mbx_id)
 		ret_val = mbx->ops[mbx_id].read(hw, msg, size, mbx_id);
 		if (!ret_val)
 			ixgbe_mbx_reset_timeout(hw);
-		return ret_val;
 	}
 
+	ixgbe_mbx_account(hw, ret_val ? NULL : msg, ret_val);
+	if (mbx->trace)
+		mbx->trace(hw, msg, size, ret_val, false);
+
 	return ret_val;
 }
 
@@ -104,9 +165,16 @@ s32 ixgbe_write_mbx(struct ixgbe_hw *hw, u32 *msg, u16 size, u16 mbx_id)
 		ERROR_REPORT2(IXGBE_ERROR_ARGUMENT,
 			     "Invalid mailbox message size %u", size);
 	} else {
+		mbx->req_opcode = msg[0] & 0xFFFF;
+		mbx->req_start_ns = ktime_get_ns();
 		ret_val = mbx->ops[mbx_id].write(hw, msg, size, mbx_id);
+		if (ret_val)
+			ixgbe_mbx_account(hw, NULL, ret_val);
 	}
 
+	if (mbx->trace)
+		mbx->trace(hw, msg, size, ret_val, true);
+
 	return ret_val;
 }
 
@@ -165,7 +233,8 @@ static s32 ixgbe_poll_for_msg(struct ixgbe_hw *hw, u16 mbx_id)
 		countdown--;
 		if (!countdown)
 			break;
-		udelay(mbx->udelay);
+		mbx->stats.retries++;
+		ixgbe_mbx_delay(hw);
 	}
 
 	if (countdown == 0) {
@@ -195,7 +264,8 @@ static s32 ixgbe_poll_for_ack(struct ixgbe_hw *hw, u16 mbx_id)
 		countdown--;
 		if (!countdown)
 			break;
-		udelay(mbx->udelay);
+		mbx->stats.retries++;
+		ixgbe_mbx_delay(hw);
 	}
 
 	if (countdown == 0) {
@@ -254,6 +324,20 @@ static void ixgbe_clear_rst_vf(struct ixgbe_hw *hw)
 	}
 }
 
+/**
+ * ixgbe_check_pf_msg_vf - note a message the PF sent unprompted
+ * @hw: pointer to the HW structure
+ * @msg: first word of the message read from the PF
+ *
+ * Replies to our requests carry CTS, control messages (link change, PF
+ * reset) carry IXGBE_PF_CONTROL_MSG or, after a PF reset, no CTS.
+ **/
+static void ixgbe_check_pf_msg_vf(struct ixgbe_hw *hw, u32 msg)
+{
+	if ((msg & IXGBE_PF_CONTROL_MSG) || !(msg & IXGBE_VT_MSGTYPE_CTS))
+		hw->mbx.pf_msg = true;
+}
+
 /**
  * ixgbe_check_for_bit_vf - Determine if a status bit was set
  * @hw: pointer to the HW structure
@@ -336,9 +420,10 @@ static s32 ixgbe_check_for_rst_vf(struct ixgbe_hw *hw, u16 mbx_id)
 static s32 ixgbe_obtain_mbx_lock_vf(struct ixgbe_hw *hw)
 {
 	struct ixgbe_mbx_info *mbx = &hw->mbx;
+	u64 start_ns = ktime_get_ns();
 	int countdown = mbx->timeout;
 	s32 ret_val = IXGBE_ERR_MBX;
-	u32 vf_mailbox;
+	u32 vf_mailbox, usecs;
 
 	if (!mbx->timeout)
 		return IXGBE_ERR_CONFIG;
@@ -364,9 +449,16 @@ static s32 ixgbe_obtain_mbx_lock_vf(struct ixgbe_hw *hw)
 
 	retry:
 		/* Wait a bit before trying again */
-		udelay(mbx->udelay);
+		mbx->stats.lock_retries++;
+		ixgbe_mbx_delay(hw);
 	}
 
+	usecs = min_t(u64, div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC),
+		      U32_MAX);
+	mbx->stats.lock_wait_us += usecs;
+	if (usecs > mbx->stats.lock_wait_max_us)
+		mbx->stats.lock_wait_max_us = usecs;
+
 	if (ret_val != 0) {
 		ERROR_REPORT1(IXGBE_ERROR_INVALID_STATE,
 				"Failed to obtain mailbox lock");
@@ -425,8 +517,11 @@ static s32 ixgbe_write_mbx_vf_legacy(struct ixgbe_hw *hw, u32 *msg, u16 size,
 	if (ret_val)
 		return ret_val;
 
-	/* flush msg and acks as we are overwriting the message buffer */
-	ixgbe_check_for_msg_vf(hw, 0);
+	/* flush msg and acks as we are overwriting the message buffer, a
+	 * message still pending here was never asked for
+	 */
+	if (!ixgbe_check_for_msg_vf(hw, 0))
+		hw->mbx.pf_msg = true;
 	ixgbe_clear_msg_vf(hw);
 	ixgbe_check_for_ack_vf(hw, 0);
 	ixgbe_clear_ack_vf(hw);
@@ -467,7 +562,11 @@ static s32 ixgbe_write_mbx_vf(struct ixgbe_hw *hw, u32 *msg, u16 size,
 	if (ret_val)
 		return ret_val;
 
-	/* flush msg and acks as we are overwriting the message buffer */
+	/* flush msg and acks as we are overwriting the message buffer, a
+	 * message still pending here was never asked for
+	 */
+	if (!ixgbe_check_for_msg_vf(hw, 0))
+		hw->mbx.pf_msg = true;
 	ixgbe_clear_msg_vf(hw);
 	ixgbe_clear_ack_vf(hw);
 
@@ -504,6 +603,7 @@ static s32 ixgbe_write_mbx_vf(struct ixgbe_hw *hw, u32 *msg, u16 size,
 static s32 ixgbe_read_mbx_vf_legacy(struct ixgbe_hw *hw, u32 *msg, u16 size,
 				    u16 mbx_id)
 {
+	bool pending;
 	s32 ret_val;
 	u16 i;
 
@@ -514,10 +614,18 @@ static s32 ixgbe_read_mbx_vf_legacy(struct ixgbe_hw *hw, u32 *msg, u16 size,
 	if (ret_val)
 		return ret_val;
 
+	/* the buffer is read regardless, only a new message is classified */
+	pending = !ixgbe_check_for_msg_vf(hw, 0);
+
 	/* copy the message from the mailbox memory buffer */
 	for (i = 0; i < size; i++)
 		msg[i] = IXGBE_READ_REG_ARRAY(hw, IXGBE_VFMBMEM, i);
 
+	if (pending) {
+		ixgbe_clear_msg_vf(hw);
+		ixgbe_check_pf_msg_vf(hw, msg[0]);
+	}
+
 	/* Acknowledge receipt and release mailbox, then we're done */
 	IXGBE_WRITE_REG(hw, IXGBE_VFMAILBOX, IXGBE_VFMAILBOX_ACK);
 
@@ -555,6 +663,7 @@ static s32 ixgbe_read_mbx_vf(struct ixgbe_hw *hw, u32 *msg, u16 size,
 	/* copy the message from the mailbox memory buffer */
 	for (i = 0; i < size; i++)
 		msg[i] = IXGBE_READ_REG_ARRAY(hw, IXGBE_VFMBMEM, i);
+	ixgbe_check_pf_msg_vf(hw, msg[0]);
 
 	/* Acknowledge receipt */
 	vf_mailbox = ixgbe_read_mailbox_vf(hw);
@@ -592,6 +701,9 @@ void ixgbe_init_mbx_params_vf(struct ixgbe_hw *hw)
 	mbx->ops[0].check_for_rst = ixgbe_check_for_rst_vf;
 	mbx->ops[0].clear = NULL;
 
+	/* no request is outstanding until the first ixgbe_write_mbx() */
+	mbx->req_opcode = IXGBE_MBX_STATS_OPCODES;
+
 	mbx->stats.msgs_tx = 0;
 	mbx->stats.msgs_rx = 0;
 	mbx->stats.reqs = 0;
@@ -17,6 +17,19 @@ struct ixgbe_mbx_operations {
 	s32  (*clear)(struct ixgbe_hw *hw, u16 vf_number);
 };
 
+/* request opcodes with their own counters, covers every IXGBE_VF_* type */
+#define IXGBE_MBX_STATS_OPCODES		32
+/* round trip histogram, bucket n holds [2^(n-1), 2^n) usecs */
+#define IXGBE_MBX_STATS_BUCKETS		16
+
+struct ixgbe_mbx_op_stats {
+	u32 latency[IXGBE_MBX_STATS_BUCKETS];
+	u32 nacks;
+	u32 timeouts;
+	u32 max_us;
+	u64 total_us;
+};
+
 struct ixgbe_mbx_stats {
 	u32 msgs_tx;
 	u32 msgs_rx;
@@ -24,6 +37,15 @@ struct ixgbe_mbx_stats {
 	u32 acks;
 	u32 reqs;
 	u32 rsts;
+
+	/* kept across mailbox re-inits, unlike the counters above */
+	u32 timeouts;		/* request or reply never arrived */
+	u32 nacks;		/* replies with IXGBE_VT_MSGTYPE_FAILURE */
+	u32 retries;		/* polling intervals waited for the PF */
+	u32 lock_retries;	/* mailbox found owned by the PF or VF */
+	u32 lock_wait_max_us;
+	u64 lock_wait_us;
+	struct ixgbe_mbx_op_stats op[IXGBE_MBX_STATS_OPCODES];
 };
 
 struct ixgbe_mbx_info {
@@ -38,10 +60,26 @@ struct ixgbe_mbx_info {
 	u32 udelay;
 	u32 vf_mailbox;
 	u16 size;
+	bool pf_msg;		/* VF: a message the PF sent on its own was
+				 * read or discarded, cleared by the OS layer
+				 */
 
 	u32 msg_timeout_count;	/* suppressed timeouts since last print */
 	u8  msg_exp;		/* current backoff exponent (0..16) */
 	unsigned long msg_window_end;	/* jiffies when quiet window expires */
+
+	/* optional, set by the OS layer when mailbox callers may sleep: waits
+	 * up to usecs and returns early once the PF raised a mailbox event
+	 */
+	void (*wait)(struct ixgbe_hw *hw, u32 usecs);
+
+	/* optional, called after every ixgbe_write_mbx()/ixgbe_poll_mbx() */
+	void (*trace)(struct ixgbe_hw *hw, u32 *msg, u16 size, s32 ret_val,
+		      bool write);
+
+	/* request in flight, for the per-opcode statistics */
+	u16 req_opcode;
+	u64 req_start_ns;
 };
 
 #include "ixgbe_vf.h"
@@ -268,7 +268,7 @@ s32 ixgbe_stop_adapter_vf(struct ixgbe_hw *hw)
  * by the MO field of the MCSTCTRL. The MO field is set during initialization
  * to mc_filter_type.
  **/
-static s32 ixgbe_mta_vector(struct ixgbe_hw *hw, u8 *mc_addr)
+s32 ixgbe_mta_vector(struct ixgbe_hw *hw, u8 *mc_addr)
 {
 	u32 vector = 0;
 
@@ -363,16 +363,15 @@ s32 ixgbe_update_mc_addr_list_vf(struct ixgbe_hw *hw, u8 *mc_addr_list,
 
 	/* Each entry in the list uses 1 16 bit word.  We have 30
 	 * 16 bit words available in our HW msg buffer (minus 1 for the
-	 * msg type).  That's 30 hash values if we pack 'em right.  If
-	 * there are more than 30 MC addresses to add then punt the
-	 * extras for now and then add code to handle more than 30 later.
-	 * It would be unusual for a server to request that many multi-cast
-	 * addresses except for in large enterprise network environments.
+	 * msg type).  That's 30 hash values if we pack 'em right.  The PF
+	 * replaces the whole table on every message, so anything past
+	 * that is dropped here; callers that need more filters than fit
+	 * should request IXGBEVF_XCAST_MODE_ALLMULTI instead.
 	 */
 
 	hw_dbg(hw, "MC Addr Count = %d\n", mc_addr_count);
 
-	cnt = (mc_addr_count > 30) ? 30 : mc_addr_count;
+	cnt = min_t(u32, mc_addr_count, IXGBE_VF_MC_HASHES_MAX);
 	msgbuf[0] = IXGBE_VF_SET_MULTICAST;
 	msgbuf[0] |= cnt << IXGBE_VT_MSGINFO_SHIFT;
 
@@ -11,6 +11,9 @@
 /* DCB define */
 #define IXGBE_VF_MAX_TRAFFIC_CLASS	8
 
+/* multicast hashes carried by one IXGBE_VF_SET_MULTICAST message */
+#define IXGBE_VF_MC_HASHES_MAX	((IXGBE_VFMAILBOX_SIZE - 1) * 2)
+
 #define IXGBE_VFCTRL		0x00000
 #define IXGBE_VFSTATUS		0x00008
 #define IXGBE_VFLINKS		0x00010
@@ -175,6 +178,7 @@ s32 ixgbevf_set_uc_addr_vf(struct ixgbe_hw *hw, u32 index, u8 *addr);
 s32 ixgbe_update_mc_addr_list_vf(struct ixgbe_hw *hw, u8 *mc_addr_list,
 				 u32 mc_addr_count, ixgbe_mc_addr_itr,
 				 bool clear);
+s32 ixgbe_mta_vector(struct ixgbe_hw *hw, u8 *mc_addr);
 s32 ixgbevf_update_xcast_mode(struct ixgbe_hw *hw, int xcast_mode);
 s32 ixgbe_get_link_state_vf(struct ixgbe_hw *hw, bool *link_state);
 s32 ixgbe_set_vfta_vf(struct ixgbe_hw *hw, u32 vlan, u32 vind,
@@ -51,21 +51,22 @@
 #define DESC_NEEDED (MAX_SKB_FRAGS + 4)
 
 /* wrapper around a pointer to a socket buffer,
- * so a DMA handle can be stored along with the buffer */
+ * so a DMA handle can be stored along with the buffer
+ * (40 bytes on 64-bit, see ixgbevf_check_layout())
+ */
 struct ixgbevf_tx_buffer {
 	union ixgbe_adv_tx_desc *next_to_watch;
-	unsigned long time_stamp;
 	union {
 		struct sk_buff *skb;
 		/* XDP uses address ptr on irq_clean */
 		void *data;
 	};
-	unsigned int bytecount;
-	unsigned short gso_segs;
-	__be16 protocol;
 	DEFINE_DMA_UNMAP_ADDR(dma);
 	DEFINE_DMA_UNMAP_LEN(len);
+	unsigned int bytecount;
 	u32 tx_flags;
+	unsigned short gso_segs;
+	__be16 protocol;
 };
 
 struct ixgbevf_rx_buffer {
@@ -100,16 +101,23 @@ struct ixgbevf_rx_queue_stats {
 	u64 alloc_rx_buff_failed;
 	u64 alloc_rx_page;
 	u64 csum_err;
+	u64 backlog_high;	/* polls that found the ring over half full */
 };
 
 enum ixgbevf_ring_state_t {
 	__IXGBEVF_RX_3K_BUFFER,
+	__IXGBEVF_RX_1K_BUFFER,
 	__IXGBEVF_RX_BUILD_SKB_ENABLED,
 	__IXGBEVF_TX_DETECT_HANG,
 	__IXGBEVF_HANG_CHECK_ARMED,
 	__IXGBEVF_RX_CSUM_UDP_ZERO_ERR,
 	__IXGBEVF_TX_XDP_RING,
 	__IXGBEVF_TX_XDP_RING_PRIMED,
+	__IXGBEVF_TX_XPS_INIT_DONE,
+	__IXGBEVF_TX_RESTART_REQUESTED,
+	__IXGBEVF_RX_PARKED,
+	__IXGBEVF_RX_TRIMMED,
+	__IXGBEVF_TX_STOPPED,	/* quiesced on its own, do not wake or post */
 };
 
 #define ring_is_xdp(ring) \
@@ -120,34 +128,33 @@ enum ixgbevf_ring_state_t {
 		clear_bit(__IXGBEVF_TX_XDP_RING, &(ring)->state)
 
 struct ixgbevf_ring {
-	struct ixgbevf_ring *next;
-	struct ixgbevf_q_vector *q_vector; /* backpointer to host q_vector */
-	struct net_device *netdev;	/* netdev ring belongs to */
-	struct bpf_prog *xdp_prog;
-	struct device *dev;		/* device for DMA mapping */
+	/* read for every packet, one cache line on 64-bit */
 	void *desc;			/* descriptor ring memory */
 	union {
 		struct ixgbevf_tx_buffer *tx_buffer_info;
 		struct ixgbevf_rx_buffer *rx_buffer_info;
 	};
-	unsigned long state;
 	u8 __iomem *tail;
-	dma_addr_t dma;			/* phys. address of descriptor ring */
-	unsigned int size;		/* length in bytes */
-
+	struct device *dev;		/* device for DMA mapping */
+	struct net_device *netdev;	/* netdev ring belongs to */
+	struct ixgbevf_q_vector *q_vector; /* backpointer to host q_vector */
+	unsigned long state;
 	u16 count;			/* amount of descriptors */
+	u16 next_to_use;
+	u16 next_to_clean;
+	u16 next_to_alloc;
 
+	/* read once per poll, or written back with the packet counts */
+	struct ixgbevf_ring *next;
+	struct bpf_prog *xdp_prog;
+	struct sk_buff *skb;
+	u16 fill_limit;			/* Rx buffers posted at most */
 	u8 queue_index;		/* needed for multiqueue queue management */
 	u8 reg_idx;		/* holds the special value that gets
 				 * the hardware register offset
 				 * associated with this ring, which is
 				 * different for DCB and RSS modes
 				 */
-	struct sk_buff *skb;
-	u16 next_to_use;
-	u16 next_to_clean;
-	u16 next_to_alloc;
-
 	struct ixgbevf_stats stats;
 #ifdef HAVE_NDO_GET_STATS64
 	struct u64_stats_sync	syncp;
@@ -156,6 +163,13 @@ struct ixgbevf_ring {
 		struct ixgbevf_tx_queue_stats tx_stats;
 		struct ixgbevf_rx_queue_stats rx_stats;
 	};
+
+	/* setup and service task only */
+	dma_addr_t dma;			/* phys. address of descriptor ring */
+	unsigned int size;		/* length in bytes */
+	int numa_node;			/* node desc/buffer_info live on */
+	u64 reclaim_packets;		/* packets seen by the last idle check */
+	u8 reclaim_idle;		/* consecutive idle checks */
 #ifdef HAVE_XDP_BUFF_RXQ
 	struct xdp_rxq_info xdp_rxq;
 #endif
@@ -167,12 +181,37 @@ struct ixgbevf_ring {
 #define MAX_RX_QUEUES IXGBE_VF_MAX_RX_QUEUES
 #define MAX_TX_QUEUES IXGBE_VF_MAX_TX_QUEUES
 #define MAX_XDP_QUEUES IXGBE_VF_MAX_TX_QUEUES
-#define IXGBEVF_MAX_RSS_QUEUES		2
+#define IXGBEVF_MAX_RSS_QUEUES		8	/* X550 and later, 8-bit VFRETA */
+#define IXGBEVF_82599_MAX_RSS_QUEUES	4	/* PF packs RETA 2 bits/entry */
 #define IXGBEVF_82599_RETA_SIZE		128	/* 128 entries */
 #define IXGBEVF_X550_VFRETA_SIZE	64	/* 64 entries */
 #define IXGBEVF_RSS_HASH_KEY_SIZE	40
 #define IXGBEVF_VFRSSRK_REGS		10	/* 10 registers for RSS key */
 
+/* ring auto-tuning, see IXGBEVF_FLAG_RING_AUTOTUNE: rings grow under
+ * pressure and shrink after IDLE_PERIODS intervals without turning over
+ */
+#define IXGBEVF_AUTOTUNE_INTERVAL	(2 * HZ)
+#define IXGBEVF_AUTOTUNE_IDLE_PERIODS	15
+#define IXGBEVF_AUTOTUNE_MIN_DESC	256
+
+/* idle Rx memory reclaim, see IXGBEVF_FLAG_RX_RECLAIM: a ring without
+ * traffic for IDLE_PERIODS service passes keeps LOW_WATER buffers posted
+ */
+#define IXGBEVF_RX_RECLAIM_IDLE_PERIODS	30
+#define IXGBEVF_RX_RECLAIM_LOW_WATER	64
+
+/* with link up, the PF is only asked for link state after a mailbox
+ * interrupt or, as a consistency check, once per interval
+ */
+#define IXGBEVF_LINK_CHECK_INTERVAL	(20 * HZ)
+
+/* minimum spacing of NUMA ring migrations triggered by IRQ affinity moves */
+#define IXGBEVF_RING_MIGRATE_INTERVAL	(10 * HZ)
+
+/* time a Tx ring gets to complete posted work before a live resize */
+#define IXGBEVF_TX_DRAIN_TIMEOUT_MS	100
+
 #define IXGBEVF_DEFAULT_TXD   1024
 #define IXGBEVF_DEFAULT_RXD   512
 #define IXGBEVF_MAX_NUM_DESCRIPTORS	4096
@@ -180,6 +219,7 @@ struct ixgbevf_ring {
 
 /* Supported Rx Buffer Sizes */
 #define IXGBEVF_RXBUFFER_256   256    /* Used for packet split */
+#define IXGBEVF_RXBUFFER_1024  1024   /* low MTU, four per 4K page */
 #define IXGBEVF_RXBUFFER_2048  2048
 #define IXGBEVF_RXBUFFER_3072  3072
 
@@ -211,6 +251,13 @@ struct ixgbevf_ring {
 #define clear_ring_uses_large_buffer(ring) \
 	clear_bit(__IXGBEVF_RX_3K_BUFFER, &(ring)->state)
 
+#define ring_uses_small_buffer(ring) \
+	test_bit(__IXGBEVF_RX_1K_BUFFER, &(ring)->state)
+#define set_ring_uses_small_buffer(ring) \
+	set_bit(__IXGBEVF_RX_1K_BUFFER, &(ring)->state)
+#define clear_ring_uses_small_buffer(ring) \
+	clear_bit(__IXGBEVF_RX_1K_BUFFER, &(ring)->state)
+
 #define ring_uses_build_skb(ring) \
 	test_bit(__IXGBEVF_RX_BUILD_SKB_ENABLED, &(ring)->state)
 #define set_ring_build_skb_enabled(ring) \
@@ -224,6 +271,9 @@ static inline unsigned int ixgbevf_rx_bufsz(struct ixgbevf_ring *ring)
 	if (ring_uses_large_buffer(ring))
 		return IXGBEVF_RXBUFFER_3072;
 
+	if (ring_uses_small_buffer(ring))
+		return IXGBEVF_RXBUFFER_1024;
+
 	if (ring_uses_build_skb(ring))
 		return IXGBEVF_MAX_FRAME_BUILD_SKB;
 #endif
@@ -241,6 +291,20 @@ static inline unsigned int ixgbevf_rx_pg_order(struct ixgbevf_ring *ring)
 
 #define ixgbevf_rx_pg_size(_ring) (PAGE_SIZE << ixgbevf_rx_pg_order(_ring))
 
+#if (PAGE_SIZE < 8192)
+/* share of a page consumed by one Rx buffer, pages are split into
+ * two halves or, with 1K buffers, into four slots
+ */
+static inline unsigned int ixgbevf_rx_slot_size(struct ixgbevf_ring *ring)
+{
+	if (ring_uses_small_buffer(ring))
+		return IXGBEVF_RXBUFFER_1024;
+
+	return ixgbevf_rx_pg_size(ring) / 2;
+}
+
+#endif
+
 #define check_for_tx_hang(ring) \
 	test_bit(__IXGBEVF_TX_DETECT_HANG, &(ring)->state)
 #define set_check_for_tx_hang(ring) \
@@ -260,6 +324,42 @@ struct ixgbevf_ring_container {
 #define ixgbevf_for_each_ring(pos, head) \
 	for (pos = (head).ring; pos != NULL; pos = pos->next)
 
+/* per-poll accounting, aggregated into the adapter by update_stats */
+struct ixgbevf_poll_stats {
+	u64 polls;		/* NAPI poll invocations */
+	u64 repolls;		/* polls that asked to be rescheduled */
+	u64 tx_limited;		/* Tx cleanups cut short by the work limit */
+	u64 rx_rebalanced;	/* polls that moved Rx budget between rings */
+	u64 xdp_deferred;	/* XDP Tx cleanups skipped while Rx was busy */
+	struct u64_stats_sync syncp;
+};
+
+/* Tx packets reclaimed per unit of NAPI budget */
+#define IXGBEVF_TX_WORK_RATIO	4
+
+/* IRQ-free polling: number of empty polls before a vector is parked on its
+ * timer, and the bounds of the exponential park interval in microseconds
+ */
+#define IXGBEVF_POLL_IDLE_SPINS		64
+#define IXGBEVF_POLL_BACKOFF_MIN	2
+#define IXGBEVF_POLL_BACKOFF_MAX	256
+
+/* software Rx fan-out: one backlog and NAPI context per CPU, fed by the
+ * queue vectors according to the Rx hash, see IXGBEVF_FLAG_RX_FANOUT
+ */
+#define IXGBEVF_FANOUT_BACKLOG	1024	/* skbs queued per CPU before drops */
+
+struct ixgbevf_rx_fanout {
+	struct sk_buff_head backlog;	/* lock protects against other CPUs */
+	struct napi_struct napi;
+	call_single_data_t csd;		/* kicks napi on the owning CPU */
+	unsigned long ipi_pending;	/* bit 0 set while csd is in flight */
+	struct ixgbevf_adapter *adapter;
+	unsigned int cpu;
+	atomic64_t ipis;		/* kicks sent to this CPU */
+	u64 dropped;			/* skbs dropped on a full backlog */
+};
+
 /* MAX_Q_VECTORS of these are allocated,
  * but we only use one per queue-specific vector.
  */
@@ -277,6 +377,23 @@ struct ixgbevf_q_vector {
 	struct rcu_head rcu;    /* to avoid race with update stats on free */
 	char name[IFNAMSIZ + 9];
 	bool netpoll_rx;
+	int numa_node;			/* node of the preferred CPU */
+#ifdef HAVE_IRQ_AFFINITY_HINT
+	cpumask_t affinity_mask;	/* preferred CPU for this vector */
+	bool affinity_applied;		/* mask applied once per MSI-X vector */
+#endif
+#ifdef HAVE_IRQ_AFFINITY_NOTIFY
+	struct irq_affinity_notify affinity_notify;
+#endif
+
+	/* IRQ-free polling state, see IXGBEVF_FLAG_IRQ_FREE_POLL */
+	struct hrtimer poll_timer;	/* re-arms NAPI once parked */
+	u16 poll_idle;			/* consecutive polls without work */
+	u16 poll_backoff;		/* current park interval in usecs */
+	struct ixgbevf_poll_stats poll_stats;
+
+	/* CPUs with fan-out backlog queued during this poll */
+	cpumask_t fanout_pending;
 
 #ifdef HAVE_NDO_BUSY_POLL
 	unsigned int state;
@@ -297,6 +414,15 @@ struct ixgbevf_q_vector {
 	struct ixgbevf_ring ring[0] ____cacheline_internodealigned_in_smp;
 };
 
+/* node whose pages the ring may recycle, see ixgbevf_can_reuse_rx_page */
+static inline int ixgbevf_ring_node(struct ixgbevf_ring *ring)
+{
+	int node = ring->q_vector ? READ_ONCE(ring->q_vector->numa_node) :
+				    NUMA_NO_NODE;
+
+	return node == NUMA_NO_NODE ? numa_mem_id() : node;
+}
+
 #ifdef HAVE_NDO_BUSY_POLL
 static inline void ixgbevf_qv_init_lock(struct ixgbevf_q_vector *q_vector)
 {
@@ -420,6 +546,15 @@ static inline u16 ixgbevf_desc_unused(struct ixgbevf_ring *ring)
 	return ((ntc > ntu) ? 0 : ring->count) + ntc - ntu - 1;
 }
 
+/* unused Rx descriptors that may be refilled without going over fill_limit */
+static inline u16 ixgbevf_rx_refill_count(struct ixgbevf_ring *ring)
+{
+	u16 withheld = ring->count - 1 - ring->fill_limit;
+	u16 unused = ixgbevf_desc_unused(ring);
+
+	return unused > withheld ? unused - withheld : 0;
+}
+
 #define IXGBEVF_RX_DESC(R, i)	    \
 	(&(((union ixgbe_adv_rx_desc *)((R)->desc))[i]))
 #define IXGBEVF_TX_DESC(R, i)	    \
@@ -432,7 +567,7 @@ static inline u16 ixgbevf_desc_unused(struct ixgbevf_ring *ring)
 #define OTHER_VECTOR 1
 #define NON_Q_VECTORS (OTHER_VECTOR)
 
-#define MAX_Q_VECTORS 2
+#define MAX_Q_VECTORS MAX_RX_QUEUES
 
 #define MIN_MSIX_Q_VECTORS 1
 #define MIN_MSIX_COUNT (MIN_MSIX_Q_VECTORS + NON_Q_VECTORS)
@@ -475,6 +610,13 @@ struct ixgbevf_adapter {
 	u16 num_rx_queues;
 	u16 rx_itr_setting;
 
+	/* queue pairs requested through ethtool -L, 0 for the default */
+	u16 num_req_queues;
+	/* traffic classes reported by the PF, the PF fixes the queue
+	 * layout when there is more than one
+	 */
+	u8 num_tcs;
+
 	/* Rings, Tx first since it is accessed in hotpath */
 	struct ixgbevf_ring *tx_ring[MAX_TX_QUEUES]; /* One per active queue */
 	struct ixgbevf_ring *xdp_ring[MAX_XDP_QUEUES];
@@ -483,6 +625,7 @@ struct ixgbevf_adapter {
 	/* interrupt vector accounting */
 	struct ixgbevf_q_vector *q_vector[MAX_Q_VECTORS];
 	int num_q_vectors;
+	int other_vector;	/* MSI-X entry of the mailbox vector */
 	struct msix_entry *msix_entries;
 
 	/* interrupt masks */
@@ -497,6 +640,15 @@ struct ixgbevf_adapter {
 	u64 alloc_rx_page_failed;
 	u64 alloc_rx_buff_failed;
 	u64 alloc_rx_page;
+	u64 napi_polls;
+	u64 napi_repolls;
+	u64 tx_clean_limited;
+	u64 rx_budget_rebalanced;
+	u64 xdp_clean_deferred;
+	u64 rx_fanout_ipis;
+	u64 rx_fanout_dropped;
+	u64 ring_autotune_resizes;
+	u64 rx_reclaim_trims;
 
 #ifndef HAVE_NETDEV_STATS_IN_NETDEV
 	struct net_device_stats net_stats;
@@ -515,16 +667,49 @@ struct ixgbevf_adapter {
 	u16 msg_enable;
 
 	u8 __iomem *io_addr;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *ixgbevf_dbg_adapter;
+#endif
 	u32 link_speed;
 	bool link_up;
+	unsigned long link_check;	/* jiffies of the last PF link query */
+	unsigned long ring_migrate_next; /* earliest next NUMA ring move */
 	bool dev_closed;
 
 	struct timer_list service_timer;
 	struct work_struct service_task;
 
-	spinlock_t mbx_lock;
+	struct work_struct rx_mode_task;
+
+	/* filters the PF last acknowledged, protected by mbx_lock */
+	bool rx_mode_synced;		/* false forces a full resend */
+	int rx_mode_xcast;
+	u16 rx_mode_mc_count;
+	u16 rx_mode_mc[IXGBE_VF_MC_HASHES_MAX];
+	u16 rx_mode_uc_count;
+	u8 *rx_mode_uc;
+
+	struct mutex mbx_lock;		/* serializes mailbox transactions */
+	wait_queue_head_t mbx_wq;	/* woken on mailbox interrupts */
 	unsigned long last_reset;
 
+	/* ring auto-tuner bounds and the counters seen on its last pass */
+	u32 tx_ring_max;
+	u32 rx_ring_max;
+	unsigned long autotune_next;
+	u64 autotune_tx_pressure;
+	u64 autotune_rx_pressure;
+	u64 autotune_tx_packets;
+	u64 autotune_rx_packets;
+	u8 autotune_tx_idle;
+	u8 autotune_rx_idle;
+
+	/* software Rx fan-out, allocated the first time it is enabled */
+	struct ixgbevf_rx_fanout __percpu *rx_fanout;
+	u16 *fanout_cpus;		/* online CPUs captured at ixgbevf_up */
+	unsigned int num_fanout_cpus;
+	bool fanout_active;		/* fan-out NAPI contexts are enabled */
+
 	u32 *rss_key;
 	u8 rss_indir_tbl[IXGBEVF_X550_VFRETA_SIZE];
 	u32 flags;
@@ -535,6 +720,12 @@ struct ixgbevf_adapter {
 #define IXGBEVF_FLAG_RSS_FIELD_IPV4_UDP		BIT(4)
 #define IXGBEVF_FLAG_RSS_FIELD_IPV6_UDP		BIT(5)
 #define IXGBE_FLAG_RX_HWTSTAMP_ENABLED		BIT(6)
+#define IXGBEVF_FLAG_IRQ_FREE_POLL		BIT(7)
+#define IXGBEVF_FLAG_RSS_INDIR_USER		BIT(8)
+#define IXGBEVF_FLAG_RX_FANOUT			BIT(9)
+#define IXGBEVF_FLAG_RING_AUTOTUNE		BIT(10)
+#define IXGBEVF_FLAG_RX_RECLAIM			BIT(11)
+#define IXGBEVF_FLAG_HYPERV			BIT(12)	/* no PF mailbox */
 };
 
 struct ixgbevf_info {
@@ -552,6 +743,12 @@ enum ixbgevf_state_t {
 	__IXGBEVF_SERVICE_INITED,
 	__IXGBEVF_RESET_REQUESTED,
 	__IXGBEVF_QUEUE_RESET_REQUESTED,
+	__IXGBEVF_RING_MIGRATE_REQUESTED,
+	__IXGBEVF_RING_RESTART_REQUESTED,
+	__IXGBEVF_WARM_RESTART,
+	__IXGBEVF_MBX_EVENT,
+	__IXGBEVF_LINK_EVENT,
+	__IXGBEVF_SUSPENDED,	/* rings and IRQs held while device is away */
 };
 
 #ifdef HAVE_VLAN_RX_REGISTER
@@ -578,12 +775,34 @@ int ixgbevf_setup_tx_resources(struct ixgbevf_ring *tx_ring);
 void ixgbevf_free_rx_resources(struct ixgbevf_ring *rx_ring);
 void ixgbevf_free_tx_resources(struct ixgbevf_ring *tx_ring);
 void ixgbevf_update_stats(struct ixgbevf_adapter *adapter);
+u16 ixgbevf_max_rss_queues(struct ixgbevf_adapter *adapter);
+u16 ixgbevf_max_channels(struct ixgbevf_adapter *adapter);
+int ixgbevf_set_queue_count(struct ixgbevf_adapter *adapter, u16 count);
+void ixgbevf_write_rss_key(struct ixgbevf_adapter *adapter);
+void ixgbevf_write_reta(struct ixgbevf_adapter *adapter);
+int ixgbevf_fanout_alloc(struct ixgbevf_adapter *adapter);
+int ixgbevf_resize_rings(struct ixgbevf_adapter *adapter, u32 new_tx_count,
+			 u32 new_rx_count);
+void ixgbevf_reconfigure_rx_rings(struct ixgbevf_adapter *adapter);
+void ixgbevf_autotune_reset(struct ixgbevf_adapter *adapter);
 #ifdef ETHTOOL_OPS_COMPAT
 int ethtool_ioctl(struct ifreq *ifr);
 #endif
 
 void ixgbevf_write_eitr(struct ixgbevf_q_vector *q_vector);
 
+#ifdef CONFIG_DEBUG_FS
+void ixgbevf_dbg_adapter_init(struct ixgbevf_adapter *adapter);
+void ixgbevf_dbg_adapter_exit(struct ixgbevf_adapter *adapter);
+void ixgbevf_dbg_init(void);
+void ixgbevf_dbg_exit(void);
+#else
+static inline void ixgbevf_dbg_adapter_init(struct ixgbevf_adapter *adapter) {}
+static inline void ixgbevf_dbg_adapter_exit(struct ixgbevf_adapter *adapter) {}
+static inline void ixgbevf_dbg_init(void) {}
+static inline void ixgbevf_dbg_exit(void) {}
+#endif /* CONFIG_DEBUG_FS */
+
 void ixgbe_napi_add_all(struct ixgbevf_adapter *adapter);
 void ixgbe_napi_del_all(struct ixgbevf_adapter *adapter);
 
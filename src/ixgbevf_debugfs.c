@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 1999 - 2026 Intel Corporation. */
+
+#include "ixgbevf.h"
+
+#ifdef CONFIG_DEBUG_FS
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static struct dentry *ixgbevf_dbg_root;
+
+static const char * const ixgbevf_mbx_opcode_names[] = {
+	[IXGBE_VF_RESET]		= "reset",
+	[IXGBE_VF_SET_MAC_ADDR]		= "set_mac_addr",
+	[IXGBE_VF_SET_MULTICAST]	= "set_multicast",
+	[IXGBE_VF_SET_VLAN]		= "set_vlan",
+	[IXGBE_VF_SET_LPE]		= "set_lpe",
+	[IXGBE_VF_SET_MACVLAN]		= "set_macvlan",
+	[IXGBE_VF_API_NEGOTIATE]	= "api_negotiate",
+	[IXGBE_VF_GET_QUEUES]		= "get_queues",
+	[IXGBE_VF_GET_RETA]		= "get_reta",
+	[IXGBE_VF_GET_RSS_KEY]		= "get_rss_key",
+	[IXGBE_VF_UPDATE_XCAST_MODE]	= "update_xcast_mode",
+	[IXGBE_VF_GET_LINK_STATE]	= "get_link_state",
+	[IXGBE_VF_GET_PF_LINK_STATE]	= "get_pf_link_state",
+	[IXGBE_VF_FEATURES_NEGOTIATE]	= "features_negotiate",
+};
+
+/**
+ * ixgbevf_dbg_mbx_show - dump the mailbox statistics
+ * @m: seq_file to print to
+ * @v: unused
+ *
+ * One line per request opcode seen so far: replies, mean and worst round
+ * trip, NACKs, timeouts and the log2(usecs) latency histogram.
+ **/
+static int ixgbevf_dbg_mbx_show(struct seq_file *m, void __always_unused *v)
+{
+	struct ixgbevf_adapter *adapter = m->private;
+	struct ixgbe_mbx_stats *stats = &adapter->hw.mbx.stats;
+	int i, j;
+
+	mutex_lock(&adapter->mbx_lock);
+
+	seq_printf(m, "msgs_tx %u msgs_rx %u timeouts %u nacks %u retries %u\n",
+		   stats->msgs_tx, stats->msgs_rx, stats->timeouts,
+		   stats->nacks, stats->retries);
+	seq_printf(m, "lock_retries %u lock_wait_us %llu lock_wait_max_us %u\n",
+		   stats->lock_retries, stats->lock_wait_us,
+		   stats->lock_wait_max_us);
+	seq_puts(m, "\nopcode               replies   avg_us   max_us  nacks timeouts  latency[0us, <2us, <4us, ... >=16ms]\n");
+
+	for (i = 0; i < IXGBE_MBX_STATS_OPCODES; i++) {
+		struct ixgbe_mbx_op_stats *op = &stats->op[i];
+		u32 replies = 0;
+
+		for (j = 0; j < IXGBE_MBX_STATS_BUCKETS; j++)
+			replies += op->latency[j];
+		if (!replies && !op->timeouts)
+			continue;
+
+		if (i < ARRAY_SIZE(ixgbevf_mbx_opcode_names) &&
+		    ixgbevf_mbx_opcode_names[i])
+			seq_printf(m, "%-18s", ixgbevf_mbx_opcode_names[i]);
+		else
+			seq_printf(m, "0x%02x              ", i);
+
+		seq_printf(m, " %10u %8llu %8u %6u %8u ", replies,
+			   replies ? div_u64(op->total_us, replies) : 0,
+			   op->max_us, op->nacks, op->timeouts);
+		for (j = 0; j < IXGBE_MBX_STATS_BUCKETS; j++)
+			seq_printf(m, " %u", op->latency[j]);
+		seq_putc(m, '\n');
+	}
+
+	mutex_unlock(&adapter->mbx_lock);
+
+	return 0;
+}
+
+static int ixgbevf_dbg_mbx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ixgbevf_dbg_mbx_show, inode->i_private);
+}
+
+static const struct file_operations ixgbevf_dbg_mbx_fops = {
+	.owner = THIS_MODULE,
+	.open = ixgbevf_dbg_mbx_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ixgbevf_dbg_adapter_init - setup the debugfs directory for the adapter
+ * @adapter: the adapter that is starting up
+ **/
+void ixgbevf_dbg_adapter_init(struct ixgbevf_adapter *adapter)
+{
+	adapter->ixgbevf_dbg_adapter =
+		debugfs_create_dir(pci_name(adapter->pdev), ixgbevf_dbg_root);
+	debugfs_create_file("mbx_stats", 0400, adapter->ixgbevf_dbg_adapter,
+			    adapter, &ixgbevf_dbg_mbx_fops);
+}
+
+/**
+ * ixgbevf_dbg_adapter_exit - clear out the adapter's debugfs entries
+ * @adapter: the adapter that is exiting
+ **/
+void ixgbevf_dbg_adapter_exit(struct ixgbevf_adapter *adapter)
+{
+	debugfs_remove_recursive(adapter->ixgbevf_dbg_adapter);
+	adapter->ixgbevf_dbg_adapter = NULL;
+}
+
+/**
+ * ixgbevf_dbg_init - start up debugfs for the driver
+ **/
+void ixgbevf_dbg_init(void)
+{
+	ixgbevf_dbg_root = debugfs_create_dir(ixgbevf_driver_name, NULL);
+}
+
+/**
+ * ixgbevf_dbg_exit - clean out the driver's debugfs entries
+ **/
+void ixgbevf_dbg_exit(void)
+{
+	debugfs_remove_recursive(ixgbevf_dbg_root);
+}
+#endif /* CONFIG_DEBUG_FS */
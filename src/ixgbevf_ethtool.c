@@ -60,6 +60,21 @@ static struct ixgbe_stats ixgbe_gstrings_stats[] = {
 	IXGBEVF_STAT("alloc_rx_page", alloc_rx_page),
 	IXGBEVF_STAT("alloc_rx_page_failed", alloc_rx_page_failed),
 	IXGBEVF_STAT("alloc_rx_buff_failed", alloc_rx_buff_failed),
+	IXGBEVF_STAT("napi_polls", napi_polls),
+	IXGBEVF_STAT("napi_repolls", napi_repolls),
+	IXGBEVF_STAT("tx_clean_limited", tx_clean_limited),
+	IXGBEVF_STAT("rx_budget_rebalanced", rx_budget_rebalanced),
+	IXGBEVF_STAT("xdp_clean_deferred", xdp_clean_deferred),
+	IXGBEVF_STAT("rx_fanout_ipis", rx_fanout_ipis),
+	IXGBEVF_STAT("rx_fanout_dropped", rx_fanout_dropped),
+	IXGBEVF_STAT("ring_autotune_resizes", ring_autotune_resizes),
+	IXGBEVF_STAT("rx_reclaim_trims", rx_reclaim_trims),
+	IXGBEVF_STAT("mbx_timeouts", hw.mbx.stats.timeouts),
+	IXGBEVF_STAT("mbx_nacks", hw.mbx.stats.nacks),
+	IXGBEVF_STAT("mbx_retries", hw.mbx.stats.retries),
+	IXGBEVF_STAT("mbx_lock_retries", hw.mbx.stats.lock_retries),
+	IXGBEVF_STAT("mbx_lock_wait_us", hw.mbx.stats.lock_wait_us),
+	IXGBEVF_STAT("mbx_lock_wait_max_us", hw.mbx.stats.lock_wait_max_us),
 };
 
 #define IXGBEVF_QUEUE_STATS_LEN ( \
@@ -84,6 +99,14 @@ static const char ixgbe_gstrings_test[][ETH_GSTRING_LEN] = {
 static const char ixgbevf_priv_flags_strings[][ETH_GSTRING_LEN] = {
 #define IXGBEVF_PRIV_FLAGS_LEGACY_RX	BIT(0)
 	"legacy-rx",
+#define IXGBEVF_PRIV_FLAGS_IRQ_FREE_POLL	BIT(1)
+	"irq-free-poll",
+#define IXGBEVF_PRIV_FLAGS_RX_FANOUT	BIT(2)
+	"rx-fanout",
+#define IXGBEVF_PRIV_FLAGS_RING_AUTOTUNE	BIT(3)
+	"ring-autotune",
+#define IXGBEVF_PRIV_FLAGS_RX_RECLAIM	BIT(4)
+	"rx-reclaim",
 };
 
 #define IXGBEVF_PRIV_FLAGS_STR_LEN ARRAY_SIZE(ixgbevf_priv_flags_strings)
@@ -687,8 +710,8 @@ static void ixgbevf_get_ringparam(struct net_device *netdev,
  * adjusts the number of descriptors for TX and RX rings, ensuring they are within
  * acceptable limits and aligned to required multiples. If the new settings differ
  * from the current configuration, the function reallocates resources and updates
- * the ring counts. The network interface is brought down and back up to apply
- * the changes.
+ * the ring counts through ixgbevf_resize_rings(). While ring auto-tuning is
+ * enabled the requested sizes also become the tuner's upper bounds.
  *
  * The function supports conditional compilation to accommodate different kernel
  * versions, which may require additional parameters for extended acknowledgment.
@@ -707,9 +730,7 @@ static int ixgbevf_set_ringparam(struct net_device *netdev,
 #endif
 {
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
-	struct ixgbevf_ring *tx_ring = NULL, *rx_ring = NULL;
 	u32 new_rx_count, new_tx_count;
-	int i, j, err = 0;
 
 	if ((ring->rx_mini_pending) || (ring->rx_jumbo_pending))
 		return -EINVAL;
@@ -731,152 +752,18 @@ static int ixgbevf_set_ringparam(struct net_device *netdev,
 	new_rx_count = ALIGN(ring->rx_pending,
 			     IXGBE_REQ_RX_DESCRIPTOR_MULTIPLE);
 
+	/* with ring-autotune on, the sizes given here bound the tuner */
+	if (adapter->flags & IXGBEVF_FLAG_RING_AUTOTUNE) {
+		adapter->tx_ring_max = new_tx_count;
+		adapter->rx_ring_max = new_rx_count;
+	}
+
 	/* if nothing to do return success */
 	if ((new_tx_count == adapter->tx_ring_count) &&
 	    (new_rx_count == adapter->rx_ring_count))
 		return 0;
 
-	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
-		msleep(1);
-
-	if (!netif_running(adapter->netdev)) {
-		for (i = 0; i < adapter->num_tx_queues; i++)
-			adapter->tx_ring[i]->count = new_tx_count;
-		for (i = 0; i < adapter->num_xdp_queues; i++)
-			adapter->xdp_ring[i]->count = new_tx_count;
-		for (i = 0; i < adapter->num_rx_queues; i++)
-			adapter->rx_ring[i]->count = new_rx_count;
-		adapter->tx_ring_count = new_tx_count;
-		adapter->xdp_ring_count = new_tx_count;
-		adapter->rx_ring_count = new_rx_count;
-		goto clear_reset;
-	}
-
-	if (new_tx_count != adapter->tx_ring_count) {
-		tx_ring = vmalloc((adapter->num_tx_queues +
-				   adapter->num_xdp_queues) * sizeof(*tx_ring));
-		if (!tx_ring) {
-			err = -ENOMEM;
-			goto clear_reset;
-		}
-
-		for (i = 0; i < adapter->num_tx_queues; i++) {
-			/* clone ring and setup updated count */
-			tx_ring[i] = *adapter->tx_ring[i];
-			tx_ring[i].count = new_tx_count;
-			err = ixgbevf_setup_tx_resources(&tx_ring[i]);
-			if (err) {
-				while (i) {
-					i--;
-					ixgbevf_free_tx_resources(&tx_ring[i]);
-				}
-
-				vfree(tx_ring);
-				tx_ring = NULL;
-
-				goto clear_reset;
-			}
-		}
-
-		for (j = 0; j < adapter->num_xdp_queues; i++, j++) {
-			/* clone ring and setup updated count */
-			tx_ring[i] = *adapter->xdp_ring[j];
-			tx_ring[i].count = new_tx_count;
-			err = ixgbevf_setup_tx_resources(&tx_ring[i]);
-			if (err) {
-				while (i) {
-					i--;
-					ixgbevf_free_tx_resources(&tx_ring[i]);
-				}
-
-				vfree(tx_ring);
-				tx_ring = NULL;
-
-				goto clear_reset;
-			}
-		}
-	}
-
-	if (new_rx_count != adapter->rx_ring_count) {
-		rx_ring = vmalloc(adapter->num_rx_queues * sizeof(*rx_ring));
-		if (!rx_ring) {
-			err = -ENOMEM;
-			goto clear_reset;
-		}
-
-		for (i = 0; i < adapter->num_rx_queues; i++) {
-			/* clone ring and setup updated count */
-			rx_ring[i] = *adapter->rx_ring[i];
-#ifdef HAVE_XDP_BUFF_RXQ
-
-			/* Clear copied XDP RX-queue info */
-			memset(&rx_ring[i].xdp_rxq, 0,
-			       sizeof(rx_ring[i].xdp_rxq));
-#endif /* HAVE_XDP_BUFF_RXQ */
-
-			rx_ring[i].count = new_rx_count;
-			err = ixgbevf_setup_rx_resources(adapter, &rx_ring[i]);
-			if (err) {
-				while (i) {
-					i--;
-					ixgbevf_free_rx_resources(&rx_ring[i]);
-				}
-
-				vfree(rx_ring);
-				rx_ring = NULL;
-
-				goto clear_reset;
-			}
-		}
-	}
-
-	/* bring interface down to prepare for update */
-	ixgbevf_down(adapter);
-
-	/* Tx */
-	if (tx_ring) {
-		for (i = 0; i < adapter->num_tx_queues; i++) {
-			ixgbevf_free_tx_resources(adapter->tx_ring[i]);
-			*adapter->tx_ring[i] = tx_ring[i];
-		}
-		adapter->tx_ring_count = new_tx_count;
-
-		for (j = 0; j < adapter->num_xdp_queues; i++, j++) {
-			ixgbevf_free_tx_resources(adapter->xdp_ring[j]);
-			*adapter->xdp_ring[j] = tx_ring[i];
-		}
-		adapter->xdp_ring_count = new_tx_count;
-
-		vfree(tx_ring);
-		tx_ring = NULL;
-	}
-
-	/* Rx */
-	if (rx_ring) {
-		for (i = 0; i < adapter->num_rx_queues; i++) {
-			ixgbevf_free_rx_resources(adapter->rx_ring[i]);
-			*adapter->rx_ring[i] = rx_ring[i];
-		}
-		adapter->rx_ring_count = new_rx_count;
-
-		vfree(rx_ring);
-		rx_ring = NULL;
-	}
-
-	/* restore interface using new values */
-	ixgbevf_up(adapter);
-
-clear_reset:
-	/* free Tx resources if Rx error is encountered */
-	if (tx_ring) {
-		for (i = 0;
-		     i < adapter->num_tx_queues + adapter->num_xdp_queues; i++)
-			ixgbevf_free_tx_resources(&tx_ring[i]);
-		vfree(tx_ring);
-	}
-
-	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
-	return err;
+	return ixgbevf_resize_rings(adapter, new_tx_count, new_rx_count);
 }
 
 /**
@@ -1824,7 +1711,6 @@ static int ixgbevf_get_reta_locked(struct ixgbe_hw *hw, u32 *reta,
 	int err, i, j;
 	u32 msgbuf[IXGBE_VFMAILBOX_SIZE];
 	u32 *hw_reta = &msgbuf[1];
-	u32 mask = 0;
 
 	/* We have to use a mailbox for 82599 and x540 devices only.
 	 * For these devices RETA has 128 entries.
@@ -1875,13 +1761,14 @@ static int ixgbevf_get_reta_locked(struct ixgbe_hw *hw, u32 *reta,
 	if (msgbuf[0] != (IXGBE_VF_GET_RETA | IXGBE_VT_MSGTYPE_SUCCESS))
 		return IXGBE_ERR_MBX;
 
-	/* ixgbevf doesn't support more than 2 queues at the moment */
-	if (num_rx_queues > 1)
-		mask = 0x1;
+	/* entries are 2 bits wide, fold them onto the queues in use */
+	if (num_rx_queues < 1)
+		num_rx_queues = 1;
 
 	for (i = 0; i < dwords; i++)
 		for (j = 0; j < 16; j++)
-			reta[i * 16 + j] = (hw_reta[i] >> (2 * j)) & mask;
+			reta[i * 16 + j] = ((hw_reta[i] >> (2 * j)) & 0x3) %
+					   num_rx_queues;
 
 	return 0;
 }
@@ -2050,7 +1937,7 @@ static int ixgbevf_get_rxfh(struct net_device *netdev, u32 *indir, u8 *key)
 		if (!indir && !key)
 			return 0;
 
-		spin_lock_bh(&adapter->mbx_lock);
+		mutex_lock(&adapter->mbx_lock);
 		if (indir)
 			err = ixgbevf_get_reta_locked(&adapter->hw, indir,
 						      adapter->num_rx_queues);
@@ -2058,13 +1945,166 @@ static int ixgbevf_get_rxfh(struct net_device *netdev, u32 *indir, u8 *key)
 		if (!err && key)
 			err = ixgbevf_get_rss_key_locked(&adapter->hw, key);
 
-		spin_unlock_bh(&adapter->mbx_lock);
+		mutex_unlock(&adapter->mbx_lock);
+	}
+
+	return err;
+}
+
+/**
+ * ixgbevf_set_rxfh - Update the RX flow hash configuration
+ * @netdev: Pointer to the network device structure
+ * @rxfh: New indirection table, hash key and hash function
+ * @extack: Netlink extended ACK, unused
+ *
+ * Older kernels pass the table, key and hash function as separate
+ * arguments instead of @rxfh; a NULL table or key is left unchanged and
+ * only the Toeplitz hash function is supported.
+ *
+ * Only X550 and later VFs own their VFRETA and VFRSSRK registers; 82599 and
+ * X540 VFs can merely query the PF's configuration. The new table and key
+ * are kept in adapter->rss_indir_tbl and adapter->rss_key, which is where
+ * ixgbevf_setup_vfmrqc() reprograms them from on every reset. A table that
+ * no longer fits after the queue count shrinks is replaced by the default.
+ *
+ * Return: 0 on success, negative error code on failure.
+ */
+#ifdef HAVE_ETHTOOL_RXFH_PARAM
+static int ixgbevf_set_rxfh(struct net_device *netdev,
+			    struct ethtool_rxfh_param *rxfh,
+			    struct netlink_ext_ack __always_unused *extack)
+#elif defined(HAVE_RXFH_HASHFUNC)
+static int ixgbevf_set_rxfh(struct net_device *netdev, const u32 *indir,
+			    const u8 *key, const u8 hfunc)
+#elif defined(HAVE_RXFH_NONCONST)
+static int ixgbevf_set_rxfh(struct net_device *netdev, u32 *indir, u8 *key)
+#else
+static int ixgbevf_set_rxfh(struct net_device *netdev, const u32 *indir,
+			    const u8 *key)
+#endif
+{
+	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
+#ifdef HAVE_ETHTOOL_RXFH_PARAM
+	u32 *indir = rxfh->indir;
+	u8 *key = rxfh->key;
+	u8 hfunc = rxfh->hfunc;
+#endif /* HAVE_ETHTOOL_RXFH_PARAM */
+	int err = 0;
+	int i;
+
+#if defined(HAVE_RXFH_HASHFUNC) || defined(HAVE_ETHTOOL_RXFH_PARAM)
+	if (hfunc != ETH_RSS_HASH_NO_CHANGE && hfunc != ETH_RSS_HASH_TOP)
+		return -EOPNOTSUPP;
+
+#endif
+	if (adapter->hw.mac.type < ixgbe_mac_X550_vf)
+		return -EOPNOTSUPP;
+
+	/* keep resets and queue count changes out until the registers match */
+	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
+		msleep(1);
+
+	if (indir) {
+		/* verify the table only points at queues we have */
+		for (i = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++) {
+			if (indir[i] >= adapter->num_rx_queues) {
+				err = -EINVAL;
+				goto out;
+			}
+		}
+
+		for (i = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++)
+			adapter->rss_indir_tbl[i] = indir[i];
+
+		adapter->flags |= IXGBEVF_FLAG_RSS_INDIR_USER;
 	}
 
+	if (key)
+		memcpy(adapter->rss_key, key, ixgbevf_get_rxfh_key_size(netdev));
+
+	/* otherwise the next ixgbevf_up() writes them for us */
+	if (!test_bit(__IXGBEVF_DOWN, &adapter->state)) {
+		if (indir)
+			ixgbevf_write_reta(adapter);
+		if (key)
+			ixgbevf_write_rss_key(adapter);
+	}
+
+out:
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
 	return err;
 }
 
 #endif /* ETHTOOL_GRSSH && ETHTOOL_SRSSH */
+#ifdef ETHTOOL_SCHANNELS
+/**
+ * ixgbevf_get_channels - report the queue configuration
+ * @netdev: network interface device structure
+ * @ch: ethtool channels structure to fill in
+ *
+ * Tx and Rx queues always come in pairs sharing a vector, so they are
+ * reported as combined channels. With traffic classes the PF hands out a
+ * single Tx queue, the remaining Rx queues are reported on their own. The
+ * mailbox vector is the only "other" channel.
+ */
+static void ixgbevf_get_channels(struct net_device *netdev,
+				 struct ethtool_channels *ch)
+{
+	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
+
+	ch->max_combined = ixgbevf_max_channels(adapter);
+	ch->max_other = NON_Q_VECTORS;
+	ch->other_count = NON_Q_VECTORS;
+
+	if (adapter->num_tcs > 1) {
+		ch->combined_count = 1;
+		ch->max_rx = adapter->num_rx_queues - 1;
+		ch->rx_count = adapter->num_rx_queues - 1;
+		return;
+	}
+
+	ch->combined_count = adapter->num_rx_queues;
+}
+
+/**
+ * ixgbevf_set_channels - change the number of combined queues
+ * @netdev: network interface device structure
+ * @ch: requested channel configuration
+ *
+ * Only the combined count can be changed, and not while the PF uses
+ * traffic classes. The q_vectors and rings are adjusted for the new count
+ * by ixgbevf_set_queue_count().
+ *
+ * Return: 0 on success, negative on failure.
+ */
+static int ixgbevf_set_channels(struct net_device *netdev,
+				struct ethtool_channels *ch)
+{
+	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
+	unsigned int count = ch->combined_count;
+
+	/* the PF fixes the queue layout for traffic classes */
+	if (adapter->num_tcs > 1)
+		return -EOPNOTSUPP;
+
+	/* verify they are not requesting separate vectors */
+	if (!count || ch->rx_count || ch->tx_count)
+		return -EINVAL;
+
+	/* verify other_count has not changed */
+	if (ch->other_count != NON_Q_VECTORS)
+		return -EINVAL;
+
+	if (count > ixgbevf_max_channels(adapter))
+		return -EINVAL;
+
+	if (count == adapter->num_rx_queues)
+		return 0;
+
+	return ixgbevf_set_queue_count(adapter, count);
+}
+
+#endif /* ETHTOOL_SCHANNELS */
 #if defined(HAVE_ETHTOOL_GET_SSET_COUNT) && defined(HAVE_SWIOTLB_SKIP_CPU_SYNC)
 /**
  * ixgbevf_get_priv_flags - Retrieve private flags for a network device
@@ -2085,6 +2125,18 @@ static u32 ixgbevf_get_priv_flags(struct net_device *netdev)
 	if (adapter->flags & IXGBEVF_FLAGS_LEGACY_RX)
 		priv_flags |= IXGBEVF_PRIV_FLAGS_LEGACY_RX;
 
+	if (adapter->flags & IXGBEVF_FLAG_IRQ_FREE_POLL)
+		priv_flags |= IXGBEVF_PRIV_FLAGS_IRQ_FREE_POLL;
+
+	if (adapter->flags & IXGBEVF_FLAG_RX_FANOUT)
+		priv_flags |= IXGBEVF_PRIV_FLAGS_RX_FANOUT;
+
+	if (adapter->flags & IXGBEVF_FLAG_RING_AUTOTUNE)
+		priv_flags |= IXGBEVF_PRIV_FLAGS_RING_AUTOTUNE;
+
+	if (adapter->flags & IXGBEVF_FLAG_RX_RECLAIM)
+		priv_flags |= IXGBEVF_PRIV_FLAGS_RX_RECLAIM;
+
 	return priv_flags;
 }
 
@@ -2096,27 +2148,64 @@ static u32 ixgbevf_get_priv_flags(struct net_device *netdev)
  * This function sets the private flags for the specified network device. Private
  * flags are driver-specific settings that can be used to control various aspects
  * of the device's behavior. The function updates the adapter's flags based on
- * the provided @priv_flags, specifically handling the IXGBEVF_FLAGS_LEGACY_RX
- * flag. If the flags are changed, the network interface is reset to repopulate
- * the queues, provided the interface is currently running.
+ * the provided @priv_flags, specifically handling the IXGBEVF_FLAGS_LEGACY_RX,
+ * IXGBEVF_FLAG_IRQ_FREE_POLL, IXGBEVF_FLAG_RX_FANOUT,
+ * IXGBEVF_FLAG_RING_AUTOTUNE and IXGBEVF_FLAG_RX_RECLAIM flags. A legacy-rx
+ * change only reconfigures the Rx rings in place; changing IRQ-free polling
+ * or Rx fan-out resets a running interface to reprogram the interrupt masks.
  *
- * Return: 0 on success.
+ * Return: 0 on success, -ENOMEM if the fan-out contexts cannot be allocated.
  */
 static int ixgbevf_set_priv_flags(struct net_device *netdev, u32 priv_flags)
 {
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
 	unsigned int flags = adapter->flags;
 
-	flags &= ~IXGBEVF_FLAGS_LEGACY_RX;
+	flags &= ~(IXGBEVF_FLAGS_LEGACY_RX | IXGBEVF_FLAG_IRQ_FREE_POLL |
+		   IXGBEVF_FLAG_RX_FANOUT);
 	if (priv_flags & IXGBEVF_PRIV_FLAGS_LEGACY_RX)
 		flags |= IXGBEVF_FLAGS_LEGACY_RX;
 
+	if (priv_flags & IXGBEVF_PRIV_FLAGS_IRQ_FREE_POLL)
+		flags |= IXGBEVF_FLAG_IRQ_FREE_POLL;
+
+	if (priv_flags & IXGBEVF_PRIV_FLAGS_RX_FANOUT) {
+		int err = ixgbevf_fanout_alloc(adapter);
+
+		if (err)
+			return err;
+
+		flags |= IXGBEVF_FLAG_RX_FANOUT;
+	}
+
+	/* the tuner and the reclaim work on live rings, no reset needed */
+	flags &= ~(IXGBEVF_FLAG_RING_AUTOTUNE | IXGBEVF_FLAG_RX_RECLAIM);
+	if (priv_flags & IXGBEVF_PRIV_FLAGS_RING_AUTOTUNE) {
+		/* start from the counters as they are now */
+		if (!(adapter->flags & IXGBEVF_FLAG_RING_AUTOTUNE))
+			ixgbevf_autotune_reset(adapter);
+		flags |= IXGBEVF_FLAG_RING_AUTOTUNE;
+	}
+
+	if (priv_flags & IXGBEVF_PRIV_FLAGS_RX_RECLAIM)
+		flags |= IXGBEVF_FLAG_RX_RECLAIM;
+	adapter->flags ^= (adapter->flags ^ flags) &
+			  (IXGBEVF_FLAG_RING_AUTOTUNE | IXGBEVF_FLAG_RX_RECLAIM);
+
 	if (flags != adapter->flags) {
+		bool reinit = (flags ^ adapter->flags) &
+			      (IXGBEVF_FLAG_IRQ_FREE_POLL |
+			       IXGBEVF_FLAG_RX_FANOUT);
+
 		adapter->flags = flags;
 
-		/* reset interface to repopulate queues */
-		if (netif_running(netdev))
+		/* legacy-rx only changes the Rx buffer layout, the others
+		 * need the vectors and interrupt masks set up again
+		 */
+		if (reinit && netif_running(netdev))
 			ixgbevf_reinit_locked(adapter);
+		else
+			ixgbevf_reconfigure_rx_rings(adapter);
 	}
 
 	return 0;
@@ -2146,6 +2235,7 @@ static struct ethtool_ops ixgbevf_ethtool_ops = {
 	.get_rxfh_indir_size	= ixgbevf_get_rxfh_indir_size,
 	.get_rxfh_key_size	= ixgbevf_get_rxfh_key_size,
 	.get_rxfh		= ixgbevf_get_rxfh,
+	.set_rxfh		= ixgbevf_set_rxfh,
 #endif /* ETHTOOL_GRSSH && ETHTOOL_SRSSH */
 #endif /* HAVE_RHEL6_ETHTOOL_OPS_EXT_STRUCT */
 	.get_ringparam          = ixgbevf_get_ringparam,
@@ -2185,6 +2275,10 @@ static struct ethtool_ops ixgbevf_ethtool_ops = {
 	.get_rxnfc		= ixgbevf_get_rxnfc,
 	.set_rxnfc		= ixgbevf_set_rxnfc,
 #endif
+#if defined(ETHTOOL_SCHANNELS) && !defined(HAVE_RHEL6_ETHTOOL_OPS_EXT_STRUCT)
+	.get_channels		= ixgbevf_get_channels,
+	.set_channels		= ixgbevf_set_channels,
+#endif
 #if defined(HAVE_ETHTOOL_GET_SSET_COUNT) && defined(HAVE_SWIOTLB_SKIP_CPU_SYNC)
 	.get_priv_flags		= ixgbevf_get_priv_flags,
 	.set_priv_flags		= ixgbevf_set_priv_flags,
@@ -2199,7 +2293,12 @@ static const struct ethtool_ops_ext ixgbevf_ethtool_ops_ext = {
 	.get_rxfh_indir_size	= ixgbevf_get_rxfh_indir_size,
 	.get_rxfh_key_size	= ixgbevf_get_rxfh_key_size,
 	.get_rxfh		= ixgbevf_get_rxfh,
+	.set_rxfh		= ixgbevf_set_rxfh,
 #endif /* ETHTOOL_GRSSH && ETHTOOL_SRSSH */
+#ifdef ETHTOOL_SCHANNELS
+	.get_channels		= ixgbevf_get_channels,
+	.set_channels		= ixgbevf_set_channels,
+#endif /* ETHTOOL_SCHANNELS */
 };
 #endif /* HAVE_RHEL6_ETHTOOL_OPS_EXT_STRUCT */
 
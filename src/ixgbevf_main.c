@@ -12,6 +12,7 @@
 #include <linux/netdevice.h>
 #include <linux/vmalloc.h>
 #include <linux/string.h>
+#include <linux/sort.h>
 #include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
@@ -31,6 +32,9 @@
 #include <linux/if_vlan.h>
 #endif
 
+#ifdef HAVE_NETDEV_QUEUE_MGMT_OPS
+#include <net/netdev_queues.h>
+#endif
 #ifdef HAVE_XDP_SUPPORT
 #include <linux/bpf.h>
 #include <linux/bpf_trace.h>
@@ -38,6 +42,9 @@
 
 #endif /* HAVE_XDP_SUPPORT */
 
+#define CREATE_TRACE_POINTS
+#include "ixgbevf_trace.h"
+
 #define DRV_VERSION __stringify(5.3.36)
 #define DRV_SUMMARY __stringify(Intel(R) 10GbE PCI Express Virtual Function Driver)
 const char ixgbevf_driver_version[] = DRV_VERSION;
@@ -154,12 +161,57 @@ static void ixgbevf_service_event_complete(struct ixgbevf_adapter *adapter)
 
 /* forward decls */
 static void ixgbevf_queue_reset_subtask(struct ixgbevf_adapter *adapter);
+static void ixgbevf_ring_migrate_subtask(struct ixgbevf_adapter *adapter);
+static void ixgbevf_ring_restart_subtask(struct ixgbevf_adapter *adapter);
+static void ixgbevf_ring_autotune_subtask(struct ixgbevf_adapter *adapter);
+static void ixgbevf_rx_reclaim_subtask(struct ixgbevf_adapter *adapter);
 static void ixgbevf_set_itr(struct ixgbevf_q_vector *q_vector);
 static void ixgbevf_free_all_rx_resources(struct ixgbevf_adapter *adapter);
-static bool ixgbevf_can_reuse_rx_page(struct ixgbevf_rx_buffer *rx_buffer);
+static bool ixgbevf_can_reuse_rx_page(struct ixgbevf_ring *rx_ring,
+				      struct ixgbevf_rx_buffer *rx_buffer);
 static void ixgbevf_reuse_rx_page(struct ixgbevf_ring *rx_ring,
 				  struct ixgbevf_rx_buffer *old_buff);
 
+/**
+ * ixgbevf_mbx_wait - sleep between two mailbox polls
+ * @hw: pointer to the HW structure
+ * @usecs: polling interval
+ *
+ * Installed as hw->mbx.wait. Returns early when ixgbevf_msix_other() saw
+ * a mailbox event, so a PF answer is picked up without waiting out the
+ * interval. Callers hold adapter->mbx_lock and must be able to sleep.
+ **/
+static void ixgbevf_mbx_wait(struct ixgbe_hw *hw, u32 usecs)
+{
+	struct ixgbevf_adapter *adapter = hw->back;
+	ktime_t timeout = ns_to_ktime((u64)usecs * NSEC_PER_USEC);
+	DEFINE_WAIT(wait);
+
+	prepare_to_wait(&adapter->mbx_wq, &wait, TASK_UNINTERRUPTIBLE);
+	if (!test_and_clear_bit(__IXGBEVF_MBX_EVENT, &adapter->state))
+		schedule_hrtimeout(&timeout, HRTIMER_MODE_REL);
+	finish_wait(&adapter->mbx_wq, &wait);
+}
+
+/**
+ * ixgbevf_mbx_trace - emit the mailbox tracepoints
+ * @hw: pointer to the HW structure
+ * @msg: message written or polled
+ * @size: length of @msg in dwords
+ * @ret_val: result of the mailbox call
+ * @write: true for ixgbe_write_mbx(), false for ixgbe_poll_mbx()
+ *
+ * Installed as hw->mbx.trace.
+ **/
+static void ixgbevf_mbx_trace(struct ixgbe_hw *hw, u32 *msg, u16 size,
+			      s32 ret_val, bool write)
+{
+	if (write)
+		trace_ixgbevf_mbx_write(hw, msg, size, ret_val);
+	else
+		trace_ixgbevf_mbx_poll(hw, msg, size, ret_val);
+}
+
 static void ixgbevf_remove_adapter(struct ixgbe_hw *hw)
 {
 	struct ixgbevf_adapter *adapter = hw->back;
@@ -432,6 +484,24 @@ static void ixgbevf_tx_timeout_reset(struct ixgbevf_adapter *adapter)
 	}
 }
 
+/**
+ * ixgbevf_tx_ring_restart_request - ask the service task to restart a ring
+ * @adapter: board private structure
+ * @ring: hung Tx or XDP ring
+ *
+ * Safe to call from NAPI and from the Tx watchdog.
+ **/
+static void ixgbevf_tx_ring_restart_request(struct ixgbevf_adapter *adapter,
+					    struct ixgbevf_ring *ring)
+{
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	set_bit(__IXGBEVF_TX_RESTART_REQUESTED, &ring->state);
+	set_bit(__IXGBEVF_RING_RESTART_REQUESTED, &adapter->state);
+	ixgbevf_service_event_schedule(adapter);
+}
+
 /**
  * ixgbevf_tx_timeout - Handle a transmit timeout (Tx hang) event
  * @netdev: Pointer to the network interface device structure
@@ -451,32 +521,40 @@ static void ixgbevf_tx_timeout(struct net_device *netdev)
 {
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
 
+#ifdef HAVE_TX_TIMEOUT_TXQUEUE
+	if (txqueue < adapter->num_tx_queues) {
+		ixgbevf_tx_ring_restart_request(adapter,
+						adapter->tx_ring[txqueue]);
+		return;
+	}
+
+#endif
 	ixgbevf_tx_timeout_reset(adapter);
 }
 
 /**
- * ixgbevf_tx_timeout - Handle a transmit timeout (Tx hang) event
- * @netdev: Pointer to the network interface device structure
- * @txqueue: Specific transmit queue that experienced the timeout (conditionally compiled)
+ * ixgbevf_clean_tx_irq - Reclaim resources after transmit completes
+ * @q_vector: structure containing interrupt and ring information
+ * @tx_ring: Tx ring to clean
+ * @napi_budget: NAPI budget of the current poll, 0 when called from netpoll
+ * @work_limit: maximum number of packets to reclaim in this call
  *
- * This function is called in response to a transmit timeout event, commonly
- * referred to as a Tx hang. It initiates a reset of the adapter to recover
- * from the timeout condition. The function supports conditional compilation
- * to accommodate different kernel versions, which may provide the specific
- * transmit queue that experienced the timeout.
+ * Return: the number of packets reclaimed. A return value equal to
+ * @work_limit means the ring may still hold completed work.
  */
-static bool ixgbevf_clean_tx_irq(struct ixgbevf_q_vector *q_vector,
-				 struct ixgbevf_ring *tx_ring, int napi_budget)
+static int ixgbevf_clean_tx_irq(struct ixgbevf_q_vector *q_vector,
+				struct ixgbevf_ring *tx_ring, int napi_budget,
+				unsigned int work_limit)
 {
 	struct ixgbevf_adapter *adapter = q_vector->adapter;
 	struct ixgbevf_tx_buffer *tx_buffer;
 	union ixgbe_adv_tx_desc *tx_desc;
 	unsigned int total_bytes = 0, total_packets = 0;
-	unsigned int budget = tx_ring->count / 2;
+	unsigned int budget = work_limit;
 	unsigned int i = tx_ring->next_to_clean;
 
 	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
-		return true;
+		return 0;
 
 	tx_buffer = &tx_ring->tx_buffer_info[i];
 	tx_desc = IXGBEVF_TX_DESC(tx_ring, i);
@@ -583,7 +661,6 @@ static bool ixgbevf_clean_tx_irq(struct ixgbevf_q_vector *q_vector,
 		       "tx_buffer_info[next_to_clean]\n"
 		       "  next_to_watch	       <%p>\n"
 		       "  eop_desc->wb.status  <%x>\n"
-		       "  time_stamp           <%lx>\n"
 		       "  jiffies              <%lx>\n",
 		       ring_is_xdp(tx_ring) ? " XDP" : "",
 		       tx_ring->queue_index,
@@ -591,20 +668,20 @@ static bool ixgbevf_clean_tx_irq(struct ixgbevf_q_vector *q_vector,
 		       IXGBE_READ_REG(hw, IXGBE_VFTDT(tx_ring->reg_idx)),
 		       tx_ring->next_to_use, i,
 		       eop_desc, (eop_desc ? eop_desc->wb.status : 0),
-		       tx_ring->tx_buffer_info[i].time_stamp, jiffies);
+		       jiffies);
 
 		if (!ring_is_xdp(tx_ring))
 			netif_stop_subqueue(tx_ring->netdev,
 					    tx_ring->queue_index);
 
-		/* schedule immediate reset if we believe we hung */
-		ixgbevf_tx_timeout_reset(adapter);
+		/* restart just this ring, the others are fine */
+		ixgbevf_tx_ring_restart_request(adapter, tx_ring);
 
-		return true;
+		return 0;
 	}
 
 	if (ring_is_xdp(tx_ring))
-		return !!budget;
+		return work_limit - budget;
 
 	netdev_tx_completed_queue(txring_txq(tx_ring),
 				  total_packets, total_bytes);
@@ -619,21 +696,23 @@ static bool ixgbevf_clean_tx_irq(struct ixgbevf_q_vector *q_vector,
 #ifdef HAVE_TX_MQ
 		if (__netif_subqueue_stopped(tx_ring->netdev,
 					     tx_ring->queue_index) &&
-		    !test_bit(__IXGBEVF_DOWN, &adapter->state)) {
+		    !test_bit(__IXGBEVF_DOWN, &adapter->state) &&
+		    !test_bit(__IXGBEVF_TX_STOPPED, &tx_ring->state)) {
 			netif_wake_subqueue(tx_ring->netdev,
 					    tx_ring->queue_index);
 			++tx_ring->tx_stats.restart_queue;
 		}
 #else
 		if (netif_queue_stopped(tx_ring->netdev) &&
-		    !test_bit(__IXGBEVF_DOWN, &adapter->state)) {
+		    !test_bit(__IXGBEVF_DOWN, &adapter->state) &&
+		    !test_bit(__IXGBEVF_TX_STOPPED, &tx_ring->state)) {
 			netif_wake_queue(tx_ring->netdev);
 			++tx_ring->tx_stats.restart_queue;
 		}
 #endif
 	}
 
-	return !!budget;
+	return work_limit - budget;
 }
 
 #ifdef HAVE_VLAN_RX_REGISTER
@@ -656,7 +735,9 @@ static void ixgbevf_rx_vlan(struct ixgbevf_ring *rx_ring,
 
 /**
  * ixgbevf_receive_skb - Deliver a completed packet to the network stack
- * @q_vector: Pointer to the structure containing interrupt and ring information
+ * @adapter: board private structure
+ * @napi: NAPI context the packet is received on
+ * @netpoll_rx: netpoll is running, GRO must be bypassed
  * @skb: Pointer to the socket buffer (sk_buff) containing the packet to deliver
  *
  * This function sends a completed packet up the network stack. It checks for
@@ -670,33 +751,109 @@ static void ixgbevf_rx_vlan(struct ixgbevf_ring *rx_ring,
  * The function supports conditional compilation to accommodate different kernel
  * versions and configurations, including VLAN support.
  */
-static void ixgbevf_receive_skb(struct ixgbevf_q_vector *q_vector,
+static void ixgbevf_receive_skb(struct ixgbevf_adapter *adapter,
+				struct napi_struct *napi, bool netpoll_rx,
 				struct sk_buff *skb)
 {
-	struct ixgbevf_adapter *adapter = q_vector->adapter;
 	u16 vlan_tag = IXGBE_CB(skb)->vid;
 #if defined(NETIF_F_HW_VLAN_TX) || defined(NETIF_F_HW_VLAN_CTAG_TX)
 	struct vlan_group **vlgrp = &adapter->vlgrp;
 
 	if (vlan_tag & VLAN_VID_MASK && *vlgrp != NULL) {
 
-		if (q_vector->netpoll_rx)
+		if (netpoll_rx)
 			vlan_hwaccel_rx(skb, *vlgrp, vlan_tag);
 		else
-			vlan_gro_receive(&q_vector->napi,
-					 *vlgrp, vlan_tag, skb);
+			vlan_gro_receive(napi, *vlgrp, vlan_tag, skb);
 	} else {
 #endif /* NETIF_F_HW_VLAN_TX || NETIF_F_HW_CLAN_CTAG_TX */
-		if (q_vector->netpoll_rx)
+		if (netpoll_rx)
 			netif_rx(skb);
 		else
-			napi_gro_receive(&q_vector->napi, skb);
+			napi_gro_receive(napi, skb);
 #if defined(NETIF_F_HW_VLAN_TX) || defined(NETIF_F_HW_VLAN_CTAG_TX)
 	}
 #endif /* NETIF_F_HW_VLAN_TX || NETIF_F_HW_CLAN_CTAG_TX */
 }
 #endif /* HAVE_VLAN_RX_REGISTER */
 
+/**
+ * ixgbevf_deliver_skb - pass a packet to the stack on a given NAPI context
+ * @adapter: board private structure
+ * @napi: context the packet is received on, a queue vector or a fan-out CPU
+ * @netpoll_rx: netpoll is running, GRO must be bypassed
+ * @skb: packet with checksum, VLAN and hash already populated
+ **/
+static void ixgbevf_deliver_skb(struct ixgbevf_adapter *adapter,
+				struct napi_struct *napi, bool netpoll_rx,
+				struct sk_buff *skb)
+{
+#ifdef HAVE_VLAN_RX_REGISTER
+	ixgbevf_receive_skb(adapter, napi, netpoll_rx, skb);
+#else
+#ifndef HAVE_NDO_BUSY_POLL
+	if (netpoll_rx)
+		netif_rx(skb);
+	else
+#endif
+		napi_gro_receive(napi, skb);
+
+#endif
+#ifndef NETIF_F_GRO
+	adapter->netdev->last_rx = jiffies;
+#endif
+}
+
+/**
+ * ixgbevf_fanout_ipi - IPI handler that starts a CPU's fan-out NAPI
+ * @info: the ixgbevf_rx_fanout context of the interrupted CPU
+ **/
+static void ixgbevf_fanout_ipi(void *info)
+{
+	struct ixgbevf_rx_fanout *fanout = info;
+
+	clear_bit(0, &fanout->ipi_pending);
+	napi_schedule(&fanout->napi);
+}
+
+/**
+ * ixgbevf_fanout_skb - queue a received skb to the CPU picked by its hash
+ * @q_vector: vector that received the packet
+ * @skb: packet with checksum, VLAN and hash already populated
+ *
+ * Packets without an Rx hash have no flow affinity to preserve and are
+ * handed to the stack directly on the receiving CPU.
+ **/
+static void ixgbevf_fanout_skb(struct ixgbevf_q_vector *q_vector,
+			       struct sk_buff *skb)
+{
+	struct ixgbevf_adapter *adapter = q_vector->adapter;
+	struct ixgbevf_rx_fanout *fanout;
+	u32 hash = skb_get_hash_raw(skb);
+	unsigned int cpu;
+
+	if (!hash) {
+		ixgbevf_deliver_skb(adapter, &q_vector->napi, false, skb);
+		return;
+	}
+
+	cpu = adapter->fanout_cpus[((u64)hash * adapter->num_fanout_cpus) >> 32];
+	fanout = per_cpu_ptr(adapter->rx_fanout, cpu);
+
+	spin_lock(&fanout->backlog.lock);
+	if (unlikely(skb_queue_len(&fanout->backlog) >=
+		     IXGBEVF_FANOUT_BACKLOG)) {
+		fanout->dropped++;
+		spin_unlock(&fanout->backlog.lock);
+		dev_kfree_skb_any(skb);
+		return;
+	}
+	__skb_queue_tail(&fanout->backlog, skb);
+	spin_unlock(&fanout->backlog.lock);
+
+	cpumask_set_cpu(cpu, &q_vector->fanout_pending);
+}
+
 /**
  * ixgbevf_rx_skb - Determine the appropriate method to process a received packet
  * @q_vector: Pointer to the structure containing interrupt and ring information
@@ -704,15 +861,15 @@ static void ixgbevf_receive_skb(struct ixgbevf_q_vector *q_vector,
  *
  * This helper function determines the appropriate method to process a received
  * packet and send it up the network stack. It considers various factors such as
- * busy polling, netpoll, and VLAN registration to choose the correct processing
- * path:
+ * busy polling, netpoll, Rx fan-out and VLAN registration to choose the correct
+ * processing path:
  *
  * - If busy polling is enabled or netpoll is active, it uses `netif_receive_skb`
  *   to process the packet and exits early if busy polling was used.
- * - If VLAN RX registration is supported, it delegates packet processing to
- *   `ixgbevf_receive_skb`.
- * - Otherwise, it uses `napi_gro_receive` or `netif_rx` based on the netpoll
- *   status to process the packet.
+ * - With Rx fan-out active, the packet is queued to the CPU picked by its hash
+ *   and delivered from that CPU's NAPI context.
+ * - Otherwise it is passed to `ixgbevf_deliver_skb` on the vector's own NAPI
+ *   context, which takes care of VLAN registration and netpoll.
  *
  * The function supports conditional compilation to accommodate different kernel
  * versions and configurations, including busy polling and VLAN support.
@@ -720,6 +877,8 @@ static void ixgbevf_receive_skb(struct ixgbevf_q_vector *q_vector,
 static void ixgbevf_rx_skb(struct ixgbevf_q_vector *q_vector,
 			   struct sk_buff *skb)
 {
+	struct ixgbevf_adapter *adapter = q_vector->adapter;
+
 #ifdef HAVE_NDO_BUSY_POLL
 	skb_mark_napi_id(skb, &q_vector->napi);
 
@@ -729,20 +888,159 @@ static void ixgbevf_rx_skb(struct ixgbevf_q_vector *q_vector,
 		return;
 	}
 #endif /* HAVE_NDO_BUSY_POLL */
-#ifdef HAVE_VLAN_RX_REGISTER
-	ixgbevf_receive_skb(q_vector, skb);
-#else
-#ifndef HAVE_NDO_BUSY_POLL
-	if (q_vector->netpoll_rx)
-		netif_rx(skb);
-	else
-#endif
-		napi_gro_receive(&q_vector->napi, skb);
+	if (adapter->fanout_active && !q_vector->netpoll_rx) {
+		ixgbevf_fanout_skb(q_vector, skb);
+		return;
+	}
 
-#endif
-#ifndef NETIF_F_GRO
-	q_vector->adapter->netdev->last_rx = jiffies;
-#endif
+	ixgbevf_deliver_skb(adapter, &q_vector->napi, q_vector->netpoll_rx,
+			    skb);
+}
+
+/**
+ * ixgbevf_fanout_kick - schedule every CPU fed during the current poll
+ * @q_vector: vector that queued the packets
+ *
+ * Sends at most one IPI per target CPU per poll, and none while an earlier
+ * one has not been serviced yet. A CPU that went offline since the CPU list
+ * was captured has its backlog drained on the current CPU instead.
+ **/
+static void ixgbevf_fanout_kick(struct ixgbevf_q_vector *q_vector)
+{
+	struct ixgbevf_adapter *adapter = q_vector->adapter;
+	unsigned int this_cpu = smp_processor_id();
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &q_vector->fanout_pending) {
+		struct ixgbevf_rx_fanout *fanout =
+			per_cpu_ptr(adapter->rx_fanout, cpu);
+
+		if (cpu == this_cpu) {
+			napi_schedule(&fanout->napi);
+			continue;
+		}
+
+		if (test_and_set_bit(0, &fanout->ipi_pending))
+			continue;
+
+		if (smp_call_function_single_async(cpu, &fanout->csd)) {
+			clear_bit(0, &fanout->ipi_pending);
+			napi_schedule(&fanout->napi);
+			continue;
+		}
+
+		atomic64_inc(&fanout->ipis);
+	}
+
+	cpumask_clear(&q_vector->fanout_pending);
+}
+
+/**
+ * ixgbevf_fanout_poll - NAPI polling callback for a fan-out backlog
+ * @napi: napi struct embedded in the ixgbevf_rx_fanout context
+ * @budget: amount of packets the stack allows us to process
+ *
+ * Return: number of packets passed to the stack.
+ **/
+static int ixgbevf_fanout_poll(struct napi_struct *napi, int budget)
+{
+	struct ixgbevf_rx_fanout *fanout =
+		container_of(napi, struct ixgbevf_rx_fanout, napi);
+	struct sk_buff_head queue;
+	struct sk_buff *skb;
+	int work_done = 0;
+
+	__skb_queue_head_init(&queue);
+
+	/* take a budget's worth at once so producers see the lock briefly */
+	spin_lock(&fanout->backlog.lock);
+	while (work_done < budget &&
+	       (skb = __skb_dequeue(&fanout->backlog))) {
+		__skb_queue_tail(&queue, skb);
+		work_done++;
+	}
+	spin_unlock(&fanout->backlog.lock);
+
+	while ((skb = __skb_dequeue(&queue)))
+		ixgbevf_deliver_skb(fanout->adapter, napi, false, skb);
+
+	if (work_done == budget)
+		return budget;
+
+	/* a producer may have queued behind our back while we were running */
+	if (napi_complete_done(napi, work_done) &&
+	    !skb_queue_empty(&fanout->backlog))
+		napi_schedule(napi);
+
+	return work_done;
+}
+
+/**
+ * ixgbevf_fanout_alloc - allocate the per-CPU fan-out contexts
+ * @adapter: board private structure
+ *
+ * Return: 0 on success, -ENOMEM on failure. Calling it again once the
+ * contexts exist is a no-op, they are kept until the adapter is removed.
+ **/
+int ixgbevf_fanout_alloc(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbevf_rx_fanout __percpu *rx_fanout;
+	unsigned int cpu;
+
+	if (adapter->rx_fanout)
+		return 0;
+
+	adapter->fanout_cpus = kcalloc(nr_cpu_ids, sizeof(u16), GFP_KERNEL);
+	if (!adapter->fanout_cpus)
+		return -ENOMEM;
+
+	rx_fanout = alloc_percpu(struct ixgbevf_rx_fanout);
+	if (!rx_fanout) {
+		kfree(adapter->fanout_cpus);
+		adapter->fanout_cpus = NULL;
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct ixgbevf_rx_fanout *fanout = per_cpu_ptr(rx_fanout, cpu);
+
+		skb_queue_head_init(&fanout->backlog);
+		fanout->csd.func = ixgbevf_fanout_ipi;
+		fanout->csd.info = fanout;
+		fanout->adapter = adapter;
+		fanout->cpu = cpu;
+		netif_napi_add(adapter->netdev, &fanout->napi,
+			       ixgbevf_fanout_poll);
+	}
+
+	adapter->rx_fanout = rx_fanout;
+
+	return 0;
+}
+
+/**
+ * ixgbevf_fanout_free - release the per-CPU fan-out contexts
+ * @adapter: board private structure
+ **/
+static void ixgbevf_fanout_free(struct ixgbevf_adapter *adapter)
+{
+	unsigned int cpu;
+
+	if (!adapter->rx_fanout)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ixgbevf_rx_fanout *fanout =
+			per_cpu_ptr(adapter->rx_fanout, cpu);
+
+		netif_napi_del(&fanout->napi);
+		skb_queue_purge(&fanout->backlog);
+	}
+
+	free_percpu(adapter->rx_fanout);
+	adapter->rx_fanout = NULL;
+	kfree(adapter->fanout_cpus);
+	adapter->fanout_cpus = NULL;
 }
 
 #ifdef NETIF_F_RXHASH
@@ -887,7 +1185,7 @@ static void ixgbevf_put_rx_buffer(struct ixgbevf_ring *rx_ring,
 	dma_set_attr(DMA_ATTR_WEAK_ORDERING, &attrs);
 
 #endif
-	if (ixgbevf_can_reuse_rx_page(rx_buffer)) {
+	if (ixgbevf_can_reuse_rx_page(rx_ring, rx_buffer)) {
 		/* hand second half of page back to the ring */
 		ixgbevf_reuse_rx_page(rx_ring, rx_buffer);
 	} else {
@@ -963,8 +1261,11 @@ static bool ixgbevf_alloc_mapped_page(struct ixgbevf_ring *rx_ring,
 	if (likely(page))
 		return true;
 
-	/* alloc new page for storage */
-	page = dev_alloc_pages(ixgbevf_rx_pg_order(rx_ring));
+	/* alloc new page for storage, local to the vector's CPU */
+	page = alloc_pages_node(READ_ONCE(rx_ring->q_vector->numa_node),
+				GFP_ATOMIC | __GFP_NOWARN | __GFP_COMP |
+				__GFP_MEMALLOC,
+				ixgbevf_rx_pg_order(rx_ring));
 	if (unlikely(!page)) {
 		rx_ring->rx_stats.alloc_rx_page_failed++;
 		return false;
@@ -1151,22 +1452,27 @@ static void ixgbevf_reuse_rx_page(struct ixgbevf_ring *rx_ring,
 	new_buff->pagecnt_bias = old_buff->pagecnt_bias;
 }
 
-static inline bool ixgbevf_page_is_reserved(struct page *page)
+static inline bool ixgbevf_page_is_reserved(struct page *page, int node)
 {
-	return (page_to_nid(page) != numa_mem_id()) || page_is_pfmemalloc(page);
+	return (page_to_nid(page) != node) || page_is_pfmemalloc(page);
 }
 
-static bool ixgbevf_can_reuse_rx_page(struct ixgbevf_rx_buffer *rx_buffer)
+static bool ixgbevf_can_reuse_rx_page(struct ixgbevf_ring *rx_ring,
+				      struct ixgbevf_rx_buffer *rx_buffer)
 {
 	unsigned int pagecnt_bias = rx_buffer->pagecnt_bias;
 	struct page *page = rx_buffer->page;
 
-	/* avoid re-using remote pages */
-	if (unlikely(ixgbevf_page_is_reserved(page)))
+	/* avoid re-using pages remote to the vector's node */
+	if (unlikely(ixgbevf_page_is_reserved(page,
+					      ixgbevf_ring_node(rx_ring))))
 		return false;
 
 #if (PAGE_SIZE < 8192)
-	/* if we are only owner of page we can reuse it */
+	/* if we are only owner of page we can reuse it, with 1K buffers
+	 * the stack may hold any of the other three slots, so the same
+	 * test guarantees the slot we move on to has been released
+	 */
 #ifdef HAVE_PAGE_COUNT_BULK_UPDATE
 	if (unlikely((page_ref_count(page) - pagecnt_bias) > 1))
 #else
@@ -1205,6 +1511,27 @@ static bool ixgbevf_can_reuse_rx_page(struct ixgbevf_rx_buffer *rx_buffer)
 	return true;
 }
 
+/**
+ * ixgbevf_rx_next_slot - move a buffer on to the next unused part of its page
+ * @rx_ring: rx descriptor ring the buffer belongs to
+ * @rx_buffer: buffer whose page_offset is advanced
+ * @truesize: bytes handed to the stack from the current slot
+ *
+ * On small pages the offset walks the two halves or four 1K slots of the
+ * page and wraps back to the first one, keeping any build_skb headroom.
+ **/
+static inline void ixgbevf_rx_next_slot(struct ixgbevf_ring *rx_ring,
+					struct ixgbevf_rx_buffer *rx_buffer,
+					unsigned int truesize)
+{
+#if (PAGE_SIZE < 8192)
+	rx_buffer->page_offset = (rx_buffer->page_offset + truesize) &
+				 (ixgbevf_rx_pg_size(rx_ring) - 1);
+#else
+	rx_buffer->page_offset += truesize;
+#endif
+}
+
 /**
  * ixgbevf_add_rx_frag - Add contents of Rx buffer to sk_buff
  * @rx_ring: rx descriptor ring to transact packets on
@@ -1220,7 +1547,7 @@ static void ixgbevf_add_rx_frag(struct ixgbevf_ring *rx_ring,
 				unsigned int size)
 {
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = ixgbevf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = ixgbevf_rx_slot_size(rx_ring);
 #else
 	unsigned int truesize = ring_uses_build_skb(rx_ring) ?
 				SKB_DATA_ALIGN(IXGBEVF_SKB_PAD + size) :
@@ -1229,11 +1556,7 @@ static void ixgbevf_add_rx_frag(struct ixgbevf_ring *rx_ring,
 
 	skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, rx_buffer->page,
 			rx_buffer->page_offset, size, truesize);
-#if (PAGE_SIZE < 8192)
-	rx_buffer->page_offset ^= truesize;
-#else
-	rx_buffer->page_offset += truesize;
-#endif
+	ixgbevf_rx_next_slot(rx_ring, rx_buffer, truesize);
 
 }
 
@@ -1245,7 +1568,7 @@ struct sk_buff *ixgbevf_construct_skb(struct ixgbevf_ring *rx_ring,
 {
 	unsigned int size = xdp->data_end - xdp->data;
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = ixgbevf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = ixgbevf_rx_slot_size(rx_ring);
 #else
 	unsigned int truesize = SKB_DATA_ALIGN(xdp->data_end -
 					       xdp->data_hard_start);
@@ -1295,11 +1618,7 @@ struct sk_buff *ixgbevf_construct_skb(struct ixgbevf_ring *rx_ring,
 				(xdp->data + headlen) -
 					page_address(rx_buffer->page),
 				size, truesize);
-#if (PAGE_SIZE < 8192)
-		rx_buffer->page_offset ^= truesize;
-#else
-		rx_buffer->page_offset += truesize;
-#endif
+		ixgbevf_rx_next_slot(rx_ring, rx_buffer, truesize);
 	} else {
 		rx_buffer->pagecnt_bias++;
 	}
@@ -1328,7 +1647,7 @@ static struct sk_buff *ixgbevf_build_skb(struct ixgbevf_ring *rx_ring,
 	void *va = xdp->data;
 #endif /* HAVE_XDP_BUFF_DATA_META */
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = ixgbevf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = ixgbevf_rx_slot_size(rx_ring);
 #else
 	unsigned int truesize = SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
 				SKB_DATA_ALIGN(xdp->data_end -
@@ -1360,11 +1679,7 @@ static struct sk_buff *ixgbevf_build_skb(struct ixgbevf_ring *rx_ring,
 #endif /* HAVE_XDP_BUFF_DATA_META */
 
 	/* update buffer offset */
-#if (PAGE_SIZE < 8192)
-	rx_buffer->page_offset ^= truesize;
-#else
-	rx_buffer->page_offset += truesize;
-#endif
+	ixgbevf_rx_next_slot(rx_ring, rx_buffer, truesize);
 
 	return skb;
 }
@@ -1505,7 +1820,7 @@ static unsigned int ixgbevf_rx_frame_truesize(struct ixgbevf_ring *rx_ring,
 	unsigned int truesize;
 
 #if (PAGE_SIZE < 8192)
-	truesize = ixgbevf_rx_pg_size(rx_ring) / 2;
+	truesize = ixgbevf_rx_slot_size(rx_ring);
 #else
 	truesize = ring_uses_build_skb(rx_ring) ?
 		SKB_DATA_ALIGN(IXGBEVF_SKB_PAD + size)
@@ -1523,11 +1838,54 @@ static void ixgbevf_rx_buffer_flip(struct ixgbevf_ring *rx_ring,
 {
 	unsigned int truesize = ixgbevf_rx_frame_truesize(rx_ring, size);
 
-#if (PAGE_SIZE < 8192)
-	rx_buffer->page_offset ^= truesize;
-#else
-	rx_buffer->page_offset += truesize;
-#endif
+	ixgbevf_rx_next_slot(rx_ring, rx_buffer, truesize);
+}
+
+/**
+ * ixgbevf_rx_sample_backlog - note whether a busy ring is over half full
+ * @rx_ring: ring whose poll just ran out of budget
+ *
+ * Looks at the posted descriptor half a ring ahead of next_to_clean, if
+ * the hardware already wrote it back the ring is filling faster than it
+ * is drained. Feeds the ring auto-tuner.
+ **/
+static void ixgbevf_rx_sample_backlog(struct ixgbevf_ring *rx_ring)
+{
+	u16 ntc = rx_ring->next_to_clean;
+	u16 probe = rx_ring->count / 2;
+	u16 posted;
+
+	posted = rx_ring->next_to_use >= ntc ?
+		 rx_ring->next_to_use - ntc :
+		 rx_ring->next_to_use + rx_ring->count - ntc;
+	if (posted <= probe)
+		return;
+
+	probe += ntc;
+	if (probe >= rx_ring->count)
+		probe -= rx_ring->count;
+
+	if (IXGBEVF_RX_DESC(rx_ring, probe)->wb.upper.length)
+		rx_ring->rx_stats.backlog_high++;
+}
+
+/**
+ * ixgbevf_rx_regrow - give a trimmed ring its buffers back as traffic returns
+ * @rx_ring: ring trimmed by the idle reclaim
+ *
+ * The fill limit doubles on every poll that received something, a burst
+ * has the ring back to full size within a few polls while a stray ARP
+ * only costs one more batch of pages.
+ **/
+static void ixgbevf_rx_regrow(struct ixgbevf_ring *rx_ring)
+{
+	u16 full = rx_ring->count - 1;
+
+	rx_ring->fill_limit = min_t(u16, rx_ring->fill_limit * 2, full);
+	if (rx_ring->fill_limit == full)
+		clear_bit(__IXGBEVF_RX_TRIMMED, &rx_ring->state);
+
+	ixgbevf_alloc_rx_buffers(rx_ring, ixgbevf_rx_refill_count(rx_ring));
 }
 
 static int ixgbevf_clean_rx_irq(struct ixgbevf_q_vector *q_vector,
@@ -1536,7 +1894,7 @@ static int ixgbevf_clean_rx_irq(struct ixgbevf_q_vector *q_vector,
 {
 	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
 	struct ixgbevf_adapter *adapter = q_vector->adapter;
-	u16 cleaned_count = ixgbevf_desc_unused(rx_ring);
+	u16 cleaned_count = ixgbevf_rx_refill_count(rx_ring);
 	struct sk_buff *skb = rx_ring->skb;
 	bool xdp_xmit = false;
 	struct xdp_buff xdp;
@@ -1669,6 +2027,18 @@ static int ixgbevf_clean_rx_irq(struct ixgbevf_q_vector *q_vector,
 	/* place incomplete frames back on ring for completion */
 	rx_ring->skb = skb;
 
+	if (total_rx_packets >= budget &&
+	    (adapter->flags & IXGBEVF_FLAG_RING_AUTOTUNE))
+		ixgbevf_rx_sample_backlog(rx_ring);
+
+	if (unlikely(test_bit(__IXGBEVF_RX_TRIMMED, &rx_ring->state)) &&
+	    total_rx_packets)
+		ixgbevf_rx_regrow(rx_ring);
+
+	if (adapter->fanout_active &&
+	    !cpumask_empty(&q_vector->fanout_pending))
+		ixgbevf_fanout_kick(q_vector);
+
 	if (xdp_xmit) {
 		struct ixgbevf_ring *xdp_ring =
 			adapter->xdp_ring[rx_ring->queue_index];
@@ -1692,80 +2062,272 @@ static int ixgbevf_clean_rx_irq(struct ixgbevf_q_vector *q_vector,
 }
 
 /**
- * ixgbevf_poll - NAPI polling callback
- * @napi: NAPI struct containing device-specific information
- * @budget: Maximum number of packets the driver is allowed to process in this pass
- *
- * This function is invoked as part of the NAPI polling mechanism to process
- * packets in the TX and RX rings associated with a `q_vector`. The function
- * attempts to clean the TX rings first, followed by the RX rings, distributing
- * the available budget fairly among the RX rings.
- *
- * The function iterates over each TX ring and calls `ixgbevf_clean_tx_irq` to
- * process completed transmissions. It then calculates a per-ring budget for
- * the RX rings and calls `ixgbevf_clean_rx_irq` to process received packets.
+ * ixgbevf_poll_timer - wake a parked vector in IRQ-free polling mode
+ * @timer: poll_timer embedded in the q_vector
  *
- * If all work is completed within the given budget, the function exits polling
- * mode by calling `napi_complete_done`. If not, it returns the budget to
- * continue polling.
+ * Return: HRTIMER_NORESTART, the next poll decides whether to re-arm.
+ */
+static enum hrtimer_restart ixgbevf_poll_timer(struct hrtimer *timer)
+{
+	struct ixgbevf_q_vector *q_vector =
+		container_of(timer, struct ixgbevf_q_vector, poll_timer);
+
+	napi_schedule(&q_vector->napi);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * ixgbevf_poll_irq_free - finish a NAPI poll without re-enabling interrupts
+ * @q_vector: vector that was just polled
+ * @work_done: number of Rx packets processed in this poll
+ * @budget: NAPI budget of this poll
  *
- * The function also handles various conditions such as checking if the network
- * interface is running, managing NAPI state, and enabling interrupts if
- * necessary.
+ * In IRQ-free polling mode the queue interrupts stay masked and NAPI keeps
+ * itself scheduled. While traffic is flowing the vector is polled back to
+ * back. After IXGBEVF_POLL_IDLE_SPINS empty polls the vector is parked on
+ * its hrtimer, and every further empty wake-up doubles the park interval up
+ * to IXGBEVF_POLL_BACKOFF_MAX usecs. Any work resets the backoff.
  *
- * Return: The number of packets processed, or the budget if more work remains.
+ * Return: @budget to stay on the poll list, or @work_done once parked.
  */
-static int ixgbevf_poll(struct napi_struct *napi, int budget)
+static int ixgbevf_poll_irq_free(struct ixgbevf_q_vector *q_vector,
+				 int work_done, int budget)
 {
-	struct ixgbevf_q_vector *q_vector =
-		container_of(napi, struct ixgbevf_q_vector, napi);
 	struct ixgbevf_adapter *adapter = q_vector->adapter;
-	struct ixgbevf_ring *ring;
-	int per_ring_budget, work_done = 0;
-	bool clean_complete = true;
 
-	ixgbevf_for_each_ring(ring, q_vector->tx) {
-		if (!ixgbevf_clean_tx_irq(q_vector, ring, budget))
-			clean_complete = false;
+	if (work_done) {
+		q_vector->poll_idle = 0;
+		q_vector->poll_backoff = IXGBEVF_POLL_BACKOFF_MIN;
 	}
 
-	if (budget <= 0)
-		return budget;
-#ifdef HAVE_NDO_BUSY_POLL
-	if (test_bit(NAPI_STATE_NPSVC, &napi->state))
+	if (q_vector->poll_idle < IXGBEVF_POLL_IDLE_SPINS) {
+		q_vector->poll_idle++;
 		return budget;
+	}
 
-	if (!ixgbevf_qv_lock_napi(q_vector))
-		return budget;
-#endif
+	if (!napi_complete_done(&q_vector->napi, work_done))
+		return work_done;
 
-	/* attempt to distribute budget to each queue fairly, but don't allow
-	 * the budget to go below 1 because we'll exit polling */
-	if (q_vector->rx.count > 1)
-		per_ring_budget = max(budget/q_vector->rx.count, 1);
-	else
-		per_ring_budget = budget;
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state) ||
+	    test_bit(__IXGBEVF_REMOVING, &adapter->state))
+		return work_done;
 
-	ixgbevf_for_each_ring(ring, q_vector->rx) {
-		int cleaned = ixgbevf_clean_rx_irq(q_vector, ring,
-						   per_ring_budget);
-		work_done += cleaned;
-		if (cleaned >= per_ring_budget)
+	hrtimer_start(&q_vector->poll_timer,
+		      ns_to_ktime(q_vector->poll_backoff * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL_PINNED);
+
+	q_vector->poll_backoff = min_t(u16, q_vector->poll_backoff * 2,
+				       IXGBEVF_POLL_BACKOFF_MAX);
+
+	return work_done;
+}
+
+/**
+ * ixgbevf_tx_work_limit - number of Tx packets one poll may reclaim
+ * @tx_ring: Tx ring about to be cleaned
+ * @budget: NAPI budget of the current poll
+ *
+ * Tx completions are cheaper than Rx packets, so a ring may reclaim
+ * IXGBEVF_TX_WORK_RATIO packets for every unit of NAPI budget, but never
+ * more than half the ring in one go.
+ *
+ * Return: the work limit to pass to ixgbevf_clean_tx_irq().
+ */
+static unsigned int ixgbevf_tx_work_limit(struct ixgbevf_ring *tx_ring,
+					  int budget)
+{
+	/* netpoll passes a zero budget, fall back to half the ring */
+	if (budget <= 0)
+		return tx_ring->count / 2;
+
+	return min_t(unsigned int, tx_ring->count / 2,
+		     budget * IXGBEVF_TX_WORK_RATIO);
+}
+
+/**
+ * ixgbevf_poll_stats_add - account one NAPI poll
+ * @q_vector: vector that was polled
+ * @tx_limited: Tx cleanups cut short by the work limit
+ * @xdp_deferred: XDP Tx cleanups left for the next poll
+ * @rebalanced: Rx budget was moved between rings
+ * @repoll: the poll asked to be rescheduled
+ **/
+static void ixgbevf_poll_stats_add(struct ixgbevf_q_vector *q_vector,
+				   unsigned int tx_limited,
+				   unsigned int xdp_deferred, bool rebalanced,
+				   bool repoll)
+{
+	struct ixgbevf_poll_stats *stats = &q_vector->poll_stats;
+
+	u64_stats_update_begin(&stats->syncp);
+	stats->polls++;
+	stats->repolls += repoll;
+	stats->tx_limited += tx_limited;
+	stats->rx_rebalanced += rebalanced;
+	stats->xdp_deferred += xdp_deferred;
+	u64_stats_update_end(&stats->syncp);
+}
+
+/**
+ * ixgbevf_poll - NAPI polling callback
+ * @napi: NAPI struct containing device-specific information
+ * @budget: Maximum number of packets the driver is allowed to process in this pass
+ *
+ * This function is invoked as part of the NAPI polling mechanism to process
+ * packets in the TX and RX rings associated with a `q_vector`.
+ *
+ * The regular TX rings are cleaned first, each bounded by
+ * ixgbevf_tx_work_limit(). The reclaimed TX work is charged against the
+ * NAPI budget at a rate of 1/IXGBEVF_TX_WORK_RATIO, but RX always keeps at
+ * least half of it. The remaining RX budget is split evenly between the RX
+ * rings, and whatever quiet rings leave unused is handed to the rings that
+ * exhausted their share in a second pass. XDP TX rings are only refilled by
+ * our own RX path, so they are cleaned after RX. While the poll is going to
+ * be repeated anyway, a ring that is less than half full is left for the
+ * next poll.
+ *
+ * If all work is completed within the given budget, the function exits polling
+ * mode by calling `napi_complete_done`. If not, it returns the budget to
+ * continue polling. Per-poll accounting is kept in `q_vector->poll_stats`.
+ *
+ * Return: The number of packets processed, or the budget if more work remains.
+ */
+static int ixgbevf_poll(struct napi_struct *napi, int budget)
+{
+	struct ixgbevf_q_vector *q_vector =
+		container_of(napi, struct ixgbevf_q_vector, napi);
+	struct ixgbevf_adapter *adapter = q_vector->adapter;
+	unsigned int tx_limited = 0, xdp_deferred = 0;
+	int per_ring_budget, rx_budget, work_done = 0;
+	unsigned int tx_limit, tx_work = 0;
+	DECLARE_BITMAP(busy_rings, MAX_RX_QUEUES);
+	struct ixgbevf_ring *ring;
+	bool clean_complete = true;
+	bool rebalanced = false;
+	int idx, busy_count;
+
+	bitmap_zero(busy_rings, MAX_RX_QUEUES);
+
+	ixgbevf_for_each_ring(ring, q_vector->tx) {
+		int cleaned;
+
+		/* XDP rings are handled once we know how much Rx did */
+		if (ring_is_xdp(ring) && budget > 0)
+			continue;
+
+		tx_limit = ixgbevf_tx_work_limit(ring, budget);
+		cleaned = ixgbevf_clean_tx_irq(q_vector, ring, budget, tx_limit);
+		tx_work += cleaned;
+		if (cleaned >= tx_limit) {
+			tx_limited++;
 			clean_complete = false;
+		}
+	}
+
+	if (budget <= 0)
+		goto out_tx_only;
+#ifdef HAVE_NDO_BUSY_POLL
+	if (test_bit(NAPI_STATE_NPSVC, &napi->state))
+		goto out_busy_poll;
+
+	if (!ixgbevf_qv_lock_napi(q_vector))
+		goto out_busy_poll;
+#endif
+
+	/* charge Tx cleanup against the budget, but leave Rx at least half */
+	rx_budget = max_t(int, budget - tx_work / IXGBEVF_TX_WORK_RATIO,
+			  DIV_ROUND_UP(budget, 2));
+
+	/* attempt to distribute budget to each queue fairly, but don't allow
+	 * the budget to go below 1 because we'll exit polling */
+	if (q_vector->rx.count > 1)
+		per_ring_budget = max(rx_budget / q_vector->rx.count, 1);
+	else
+		per_ring_budget = rx_budget;
+
+	idx = 0;
+	ixgbevf_for_each_ring(ring, q_vector->rx) {
+		int cleaned = ixgbevf_clean_rx_irq(q_vector, ring,
+						   per_ring_budget);
+		work_done += cleaned;
+		if (cleaned >= per_ring_budget && idx < MAX_RX_QUEUES)
+			__set_bit(idx, busy_rings);
+		idx++;
+	}
+
+	/* hand the budget left by quiet rings over to the busy ones */
+	busy_count = bitmap_weight(busy_rings, MAX_RX_QUEUES);
+	if (busy_count && busy_count < q_vector->rx.count &&
+	    work_done < rx_budget)
+		per_ring_budget = (rx_budget - work_done) / busy_count;
+	else
+		per_ring_budget = 0;
+
+	if (per_ring_budget) {
+		rebalanced = true;
+
+		idx = 0;
+		ixgbevf_for_each_ring(ring, q_vector->rx) {
+			int cleaned;
+
+			if (idx >= MAX_RX_QUEUES || !test_bit(idx++, busy_rings))
+				continue;
+
+			cleaned = ixgbevf_clean_rx_irq(q_vector, ring,
+						       per_ring_budget);
+			work_done += cleaned;
+			if (cleaned < per_ring_budget)
+				busy_count--;
+		}
 	}
 
+	if (busy_count)
+		clean_complete = false;
+
 #ifdef HAVE_NDO_BUSY_POLL
 	ixgbevf_qv_unlock_napi(q_vector);
 
 #endif
+	/* Rx still has work, so we poll again soon anyway: let XDP_TX
+	 * frames accumulate until then. A poll about to complete must
+	 * clean them, nothing else would before the next interrupt.
+	 */
+	ixgbevf_for_each_ring(ring, q_vector->tx) {
+		if (!ring_is_xdp(ring))
+			continue;
+
+		if (!clean_complete &&
+		    ixgbevf_desc_unused(ring) > ring->count / 2) {
+			xdp_deferred++;
+			continue;
+		}
+
+		tx_limit = ixgbevf_tx_work_limit(ring, budget);
+		if (ixgbevf_clean_tx_irq(q_vector, ring, budget,
+					 tx_limit) >= tx_limit) {
+			tx_limited++;
+			clean_complete = false;
+		}
+	}
+
 #ifndef HAVE_NETDEV_NAPI_LIST
 	if (!netif_running(adapter->netdev))
 		clean_complete = true;
 
 #endif
+	ixgbevf_poll_stats_add(q_vector, tx_limited, xdp_deferred,
+			       rebalanced, !clean_complete);
+
 	/* If all work not completed, return budget and keep polling */
-	if (!clean_complete)
+	if (!clean_complete) {
+		q_vector->poll_idle = 0;
 		return budget;
+	}
+
+	if (adapter->flags & IXGBEVF_FLAG_IRQ_FREE_POLL)
+		return ixgbevf_poll_irq_free(q_vector, work_done, budget);
+
 	/* all work done, exit the polling mode */
 	napi_complete_done(napi, work_done);
 	if (adapter->rx_itr_setting == 1)
@@ -1776,6 +2338,24 @@ static int ixgbevf_poll(struct napi_struct *napi, int budget)
 					  BIT(q_vector->v_idx));
 
 	return 0;
+
+#ifdef HAVE_NDO_BUSY_POLL
+out_busy_poll:
+	/* busy polling owns Rx, but the XDP rings skipped above are ours */
+	ixgbevf_for_each_ring(ring, q_vector->tx) {
+		if (!ring_is_xdp(ring))
+			continue;
+
+		tx_limit = ixgbevf_tx_work_limit(ring, budget);
+		if (ixgbevf_clean_tx_irq(q_vector, ring, budget,
+					 tx_limit) >= tx_limit)
+			tx_limited++;
+	}
+
+#endif
+out_tx_only:
+	ixgbevf_poll_stats_add(q_vector, tx_limited, 0, false, false);
+	return budget;
 }
 
 /**
@@ -1941,9 +2521,9 @@ static void ixgbevf_configure_msix(struct ixgbevf_adapter *adapter)
 		ixgbevf_write_eitr(q_vector);
 	}
 
-	ixgbevf_set_ivar(adapter, -1, 1, v_idx);
+	ixgbevf_set_ivar(adapter, -1, 1, adapter->other_vector);
 	/* setup eims_other and add value to global eims_enable_mask */
-	adapter->eims_other = BIT(v_idx);
+	adapter->eims_other = BIT(adapter->other_vector);
 	adapter->eims_enable_mask |= adapter->eims_other;
 }
 
@@ -2063,6 +2643,13 @@ static irqreturn_t ixgbevf_msix_other(int __always_unused irq, void *data)
 
 	hw->mac.get_link_status = 1;
 
+	/* PF message or ack, let a mailbox waiter look right away; the
+	 * service task tells PF notifications apart, see
+	 * ixgbevf_pf_msg_pending()
+	 */
+	set_bit(__IXGBEVF_MBX_EVENT, &adapter->state);
+	wake_up(&adapter->mbx_wq);
+
 	ixgbevf_service_event_schedule(adapter);
 
 	IXGBE_WRITE_REG(hw, IXGBE_VTEIMS, adapter->eims_other);
@@ -2079,6 +2666,10 @@ static irqreturn_t ixgbevf_msix_clean_rings(int __always_unused irq, void *data)
 {
 	struct ixgbevf_q_vector *q_vector = data;
 
+	/* queues are serviced by the poller, nothing to do here */
+	if (q_vector->adapter->flags & IXGBEVF_FLAG_IRQ_FREE_POLL)
+		return IRQ_HANDLED;
+
 	/* EIAM disabled interrupts (on this vector) for us */
 	if (q_vector->rx.ring || q_vector->tx.ring)
 		napi_schedule_irqoff(&q_vector->napi);
@@ -2086,6 +2677,137 @@ static irqreturn_t ixgbevf_msix_clean_rings(int __always_unused irq, void *data)
 	return IRQ_HANDLED;
 }
 
+#ifdef HAVE_IRQ_AFFINITY_NOTIFY
+/**
+ * ixgbevf_irq_affinity_notify - track the CPU a vector was moved to
+ * @notify: affinity notifier embedded in the q_vector
+ * @mask: new affinity of the vector's IRQ
+ *
+ * Called from process context whenever the IRQ affinity changes. If the
+ * vector now runs on another NUMA node, ask the service task to move the
+ * ring memory after it. Rx pages follow on their own since pages remote to
+ * the new node are no longer recycled.
+ */
+static void ixgbevf_irq_affinity_notify(struct irq_affinity_notify *notify,
+					const cpumask_t *mask)
+{
+	struct ixgbevf_q_vector *q_vector =
+		container_of(notify, struct ixgbevf_q_vector, affinity_notify);
+	struct ixgbevf_adapter *adapter = q_vector->adapter;
+	int node = cpu_to_node(cpumask_first(mask));
+
+#ifdef HAVE_IRQ_AFFINITY_HINT
+	cpumask_copy(&q_vector->affinity_mask, mask);
+#endif
+	/* read locklessly by the service task and the Rx refill path */
+	if (node == READ_ONCE(q_vector->numa_node))
+		return;
+
+	WRITE_ONCE(q_vector->numa_node, node);
+	set_bit(__IXGBEVF_RING_MIGRATE_REQUESTED, &adapter->state);
+	ixgbevf_service_event_schedule(adapter);
+}
+
+/* the notifier is embedded in the q_vector, nothing to release */
+static void ixgbevf_irq_affinity_release(struct kref __always_unused *ref)
+{
+}
+
+#endif /* HAVE_IRQ_AFFINITY_NOTIFY */
+/**
+ * ixgbevf_request_q_vector_irq - request the interrupt of one queue vector
+ * @adapter: board private structure
+ * @vector: index of the q_vector and of its MSI-X entry
+ * @ri: running Rx vector number used for the irq name
+ * @ti: running Tx vector number used for the irq name
+ *
+ * Vectors without rings are skipped.
+ *
+ * Return: 0 on success, negative on failure.
+ **/
+static int ixgbevf_request_q_vector_irq(struct ixgbevf_adapter *adapter,
+					int vector, unsigned int *ri,
+					unsigned int *ti)
+{
+	struct ixgbevf_q_vector *q_vector = adapter->q_vector[vector];
+	struct msix_entry *entry = &adapter->msix_entries[vector];
+	struct net_device *netdev = adapter->netdev;
+	int err;
+
+	if (q_vector->tx.ring && q_vector->rx.ring) {
+		snprintf(q_vector->name, sizeof(q_vector->name),
+			 "%s-TxRx-%u", netdev->name, (*ri)++);
+		(*ti)++;
+	} else if (q_vector->rx.ring) {
+		snprintf(q_vector->name, sizeof(q_vector->name),
+			 "%s-rx-%u", netdev->name, (*ri)++);
+	} else if (q_vector->tx.ring) {
+		snprintf(q_vector->name, sizeof(q_vector->name),
+			 "%s-tx-%u", netdev->name, (*ti)++);
+	} else {
+		/* skip this unused q_vector */
+		return 0;
+	}
+	err = request_irq(entry->vector, &ixgbevf_msix_clean_rings, 0,
+			  q_vector->name, q_vector);
+	if (err) {
+		DPRINTK(PROBE, ERR,
+		        "request_irq failed for MSIX interrupt "
+		        "Error: %d\n", err);
+		return err;
+	}
+#ifdef HAVE_IRQ_AFFINITY_HINT
+
+	/* Apply the preferred CPU only the first time this vector is
+	 * requested. The affinity survives free_irq(), so whatever the
+	 * admin or irqbalance sets afterwards is kept across resets
+	 * and only the hint is refreshed.
+	 */
+	if (!q_vector->affinity_applied) {
+		irq_set_affinity_and_hint(entry->vector,
+					  &q_vector->affinity_mask);
+		q_vector->affinity_applied = true;
+	} else {
+		irq_update_affinity_hint(entry->vector,
+					 &q_vector->affinity_mask);
+	}
+#endif
+#ifdef HAVE_IRQ_AFFINITY_NOTIFY
+
+	/* follow the vector if it is moved to another node */
+	q_vector->affinity_notify.notify = ixgbevf_irq_affinity_notify;
+	q_vector->affinity_notify.release = ixgbevf_irq_affinity_release;
+	irq_set_affinity_notifier(entry->vector, &q_vector->affinity_notify);
+#endif
+
+	return 0;
+}
+
+/**
+ * ixgbevf_free_q_vector_irq - release the interrupt of one queue vector
+ * @adapter: board private structure
+ * @vector: index of the q_vector and of its MSI-X entry
+ **/
+static void ixgbevf_free_q_vector_irq(struct ixgbevf_adapter *adapter,
+				      int vector)
+{
+	struct ixgbevf_q_vector *q_vector = adapter->q_vector[vector];
+	struct msix_entry *entry = &adapter->msix_entries[vector];
+
+	/* free only the irqs that were actually requested */
+	if (!q_vector->rx.ring && !q_vector->tx.ring)
+		return;
+
+#ifdef HAVE_IRQ_AFFINITY_NOTIFY
+	irq_set_affinity_notifier(entry->vector, NULL);
+#endif
+#ifdef HAVE_IRQ_AFFINITY_HINT
+	/* clear the affinity hint before the irq is released */
+	irq_update_affinity_hint(entry->vector, NULL);
+#endif
+	free_irq(entry->vector, q_vector);
+}
+
 /**
  * ixgbevf_request_msix_irqs - Initialize MSI-X interrupts
  * @adapter: board private structure
@@ -2100,34 +2822,12 @@ static int ixgbevf_request_msix_irqs(struct ixgbevf_adapter *adapter)
 	int vector, err;
 
 	for (vector = 0; vector < adapter->num_q_vectors; vector++) {
-		struct ixgbevf_q_vector *q_vector = adapter->q_vector[vector];
-		struct msix_entry *entry = &adapter->msix_entries[vector];
-
-		if (q_vector->tx.ring && q_vector->rx.ring) {
-			snprintf(q_vector->name, sizeof(q_vector->name),
-				 "%s-TxRx-%u", netdev->name, ri++);
-			ti++;
-		} else if (q_vector->rx.ring) {
-			snprintf(q_vector->name, sizeof(q_vector->name),
-				 "%s-rx-%u", netdev->name, ri++);
-		} else if (q_vector->tx.ring) {
-			snprintf(q_vector->name, sizeof(q_vector->name),
-				 "%s-tx-%u", netdev->name, ti++);
-		} else {
-			/* skip this unused q_vector */
-			continue;
-		}
-		err = request_irq(entry->vector, &ixgbevf_msix_clean_rings, 0,
-				  q_vector->name, q_vector);
-		if (err) {
-			DPRINTK(PROBE, ERR,
-			        "request_irq failed for MSIX interrupt "
-			        "Error: %d\n", err);
+		err = ixgbevf_request_q_vector_irq(adapter, vector, &ri, &ti);
+		if (err)
 			goto free_queue_irqs;
-		}
 	}
 
-	err = request_irq(adapter->msix_entries[vector].vector,
+	err = request_irq(adapter->msix_entries[adapter->other_vector].vector,
 			  &ixgbevf_msix_other, 0, netdev->name, adapter);
 	if (err) {
 		DPRINTK(PROBE, ERR,
@@ -2142,8 +2842,7 @@ static int ixgbevf_request_msix_irqs(struct ixgbevf_adapter *adapter)
 free_queue_irqs:
 	while (vector) {
 		vector--;
-		free_irq(adapter->msix_entries[vector].vector,
-			 adapter->q_vector[vector]);
+		ixgbevf_free_q_vector_irq(adapter, vector);
 	}
 	/* This failure is non-recoverable - it indicates the system is
 	 * out of MSIX vector resources and the VF driver cannot run
@@ -2190,18 +2889,10 @@ static void ixgbevf_free_irq(struct ixgbevf_adapter *adapter)
 
 	adapter->irqs_ready = false;
 
-	for (vector = 0; vector < adapter->num_q_vectors; vector++) {
-		struct ixgbevf_q_vector *q_vector = adapter->q_vector[vector];
-		struct msix_entry *entry = &adapter->msix_entries[vector];
-
-		/* free only the irqs that were actually requested */
-		if (!q_vector->rx.ring && !q_vector->tx.ring)
-			continue;
-
-		free_irq(entry->vector, q_vector);
-	}
+	for (vector = 0; vector < adapter->num_q_vectors; vector++)
+		ixgbevf_free_q_vector_irq(adapter, vector);
 
-	free_irq(adapter->msix_entries[vector].vector, adapter);
+	free_irq(adapter->msix_entries[adapter->other_vector].vector, adapter);
 }
 
 /**
@@ -2222,7 +2913,7 @@ static inline void ixgbevf_irq_disable(struct ixgbevf_adapter *adapter)
 	for (vector = 0; vector < adapter->num_q_vectors; vector++)
 		synchronize_irq(adapter->msix_entries[vector].vector);
 
-	synchronize_irq(adapter->msix_entries[vector].vector);
+	synchronize_irq(adapter->msix_entries[adapter->other_vector].vector);
 }
 
 /**
@@ -2232,10 +2923,15 @@ static inline void ixgbevf_irq_disable(struct ixgbevf_adapter *adapter)
 static inline void ixgbevf_irq_enable(struct ixgbevf_adapter *adapter)
 {
 	struct ixgbe_hw *hw = &adapter->hw;
+	u32 eims = adapter->eims_enable_mask;
 
-	IXGBE_WRITE_REG(hw, IXGBE_VTEIAM, adapter->eims_enable_mask);
-	IXGBE_WRITE_REG(hw, IXGBE_VTEIAC, adapter->eims_enable_mask);
-	IXGBE_WRITE_REG(hw, IXGBE_VTEIMS, adapter->eims_enable_mask);
+	/* only the mailbox vector is left unmasked when queues are polled */
+	if (adapter->flags & IXGBEVF_FLAG_IRQ_FREE_POLL)
+		eims = adapter->eims_other;
+
+	IXGBE_WRITE_REG(hw, IXGBE_VTEIAM, eims);
+	IXGBE_WRITE_REG(hw, IXGBE_VTEIAC, eims);
+	IXGBE_WRITE_REG(hw, IXGBE_VTEIMS, eims);
 }
 
 /**
@@ -2304,6 +3000,7 @@ static void ixgbevf_configure_tx_ring(struct ixgbevf_adapter *adapter,
 
 	clear_bit(__IXGBEVF_HANG_CHECK_ARMED, &ring->state);
 	clear_bit(__IXGBEVF_TX_XDP_RING_PRIMED, &ring->state);
+	clear_bit(__IXGBEVF_TX_RESTART_REQUESTED, &ring->state);
 
 	IXGBE_WRITE_REG(hw, IXGBE_VFTXDCTL(reg_idx), txdctl);
 
@@ -2314,6 +3011,15 @@ static void ixgbevf_configure_tx_ring(struct ixgbevf_adapter *adapter,
 	}  while (--wait_loop && !(txdctl & IXGBE_TXDCTL_ENABLE));
 	if (!wait_loop)
 		DPRINTK(HW, DEBUG, "Could not enable Tx Queue %d\n", reg_idx);
+
+#ifdef HAVE_IRQ_AFFINITY_HINT
+	/* set up XPS once per ring, later changes by the admin are kept */
+	if (!ring_is_xdp(ring) && ring->q_vector &&
+	    !test_and_set_bit(__IXGBEVF_TX_XPS_INIT_DONE, &ring->state))
+		netif_set_xps_queue(ring->netdev,
+				    &ring->q_vector->affinity_mask,
+				    ring->queue_index);
+#endif
 }
 
 /**
@@ -2344,6 +3050,8 @@ static void ixgbevf_configure_srrctl(struct ixgbevf_adapter *adapter,
 	srrctl |= IXGBEVF_RX_HDR_SIZE << IXGBE_SRRCTL_BSIZEHDRSIZE_SHIFT;
 	if (ring_uses_large_buffer(ring))
 		srrctl |= IXGBEVF_RXBUFFER_3072 >> IXGBE_SRRCTL_BSIZEPKT_SHIFT;
+	else if (ring_uses_small_buffer(ring))
+		srrctl |= IXGBEVF_RXBUFFER_1024 >> IXGBE_SRRCTL_BSIZEPKT_SHIFT;
 	else
 		srrctl |= IXGBEVF_RXBUFFER_2048 >> IXGBE_SRRCTL_BSIZEPKT_SHIFT;
 	srrctl |= IXGBE_SRRCTL_DESCTYPE_ADV_ONEBUF;
@@ -2438,29 +3146,72 @@ static inline int ixgbevf_init_rss_key(struct ixgbevf_adapter *adapter)
 	return 0;
 }
 
-static void ixgbevf_setup_vfmrqc(struct ixgbevf_adapter *adapter)
+/**
+ * ixgbevf_write_rss_key - program the RSS hash key into VFRSSRK
+ * @adapter: board private structure
+ **/
+void ixgbevf_write_rss_key(struct ixgbevf_adapter *adapter)
 {
 	struct ixgbe_hw *hw = &adapter->hw;
-	u32 vfmrqc = 0, vfreta = 0;
-	u16 rss_i = adapter->num_rx_queues;
-	u8 i, j;
+	u8 i;
 
-	/* Fill out hash function seeds */
 	for (i = 0; i < IXGBEVF_VFRSSRK_REGS; i++)
 		IXGBE_WRITE_REG(hw, IXGBE_VFRSSRK(i), adapter->rss_key[i]);
+}
 
-	for (i = 0, j = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++, j++) {
-		if (j == rss_i)
-			j = 0;
-
-		adapter->rss_indir_tbl[i] = j;
+/**
+ * ixgbevf_write_reta - program rss_indir_tbl into VFRETA
+ * @adapter: board private structure
+ *
+ * Each VFRETA register holds four 8-bit entries.
+ **/
+void ixgbevf_write_reta(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	u32 vfreta = 0;
+	u8 i;
 
-		vfreta |= j << (i & 0x3) * 8;
+	for (i = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++) {
+		vfreta |= (u32)adapter->rss_indir_tbl[i] << (i & 0x3) * 8;
 		if ((i & 3) == 3) {
 			IXGBE_WRITE_REG(hw, IXGBE_VFRETA(i >> 2), vfreta);
 			vfreta = 0;
 		}
 	}
+}
+
+static void ixgbevf_setup_vfmrqc(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	u16 rss_i = adapter->num_rx_queues;
+	u32 vfmrqc = 0;
+	u8 i, j;
+
+	/* Fill out hash function seeds */
+	ixgbevf_write_rss_key(adapter);
+
+	/* keep a table set through ethtool as long as it fits the queues */
+	if (adapter->flags & IXGBEVF_FLAG_RSS_INDIR_USER) {
+		for (i = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++) {
+			if (adapter->rss_indir_tbl[i] >= rss_i) {
+				adapter->flags &= ~IXGBEVF_FLAG_RSS_INDIR_USER;
+				e_info(drv, "RSS indirection table reset to default, it no longer fits %u queues\n",
+				       rss_i);
+				break;
+			}
+		}
+	}
+
+	if (!(adapter->flags & IXGBEVF_FLAG_RSS_INDIR_USER)) {
+		for (i = 0, j = 0; i < IXGBEVF_X550_VFRETA_SIZE; i++, j++) {
+			if (j == rss_i)
+				j = 0;
+
+			adapter->rss_indir_tbl[i] = j;
+		}
+	}
+
+	ixgbevf_write_reta(adapter);
 
 	/* Perform hash on these packet types */
 	vfmrqc |= IXGBE_MRQC_RSS_FIELD_IPV4 |
@@ -2506,9 +3257,12 @@ static void ixgbevf_configure_rx_ring(struct ixgbevf_adapter *adapter,
 	IXGBE_WRITE_REG(hw, IXGBE_VFRDT(reg_idx), 0);
 	ring->tail = adapter->io_addr + IXGBE_VFRDT(reg_idx);
 
-	/* initialize rx_buffer_info */
-	memset(ring->rx_buffer_info, 0,
-	       sizeof(struct ixgbevf_rx_buffer) * ring->count);
+	/* initialize rx_buffer_info, unless it holds pages parked across a
+	 * warm restart, those are re-posted by ixgbevf_alloc_rx_buffers
+	 */
+	if (!test_and_clear_bit(__IXGBEVF_RX_PARKED, &ring->state))
+		memset(ring->rx_buffer_info, 0,
+		       sizeof(struct ixgbevf_rx_buffer) * ring->count);
 
 	/* initialize Rx descriptor 0 */
 	rx_desc = IXGBEVF_RX_DESC(ring, 0);
@@ -2543,32 +3297,60 @@ static void ixgbevf_configure_rx_ring(struct ixgbevf_adapter *adapter,
 	rxdctl |= IXGBE_RXDCTL_ENABLE | IXGBE_RXDCTL_VME;
 	IXGBE_WRITE_REG(hw, IXGBE_VFRXDCTL(reg_idx), rxdctl);
 
+	/* a ring trimmed while idle stays trimmed until traffic returns */
+	if (test_bit(__IXGBEVF_RX_TRIMMED, &ring->state))
+		ring->fill_limit = min_t(u16, ring->fill_limit, ring->count - 1);
+	else
+		ring->fill_limit = ring->count - 1;
+
 	ixgbevf_rx_desc_queue_enable(adapter, ring);
-	ixgbevf_alloc_rx_buffers(ring, ixgbevf_desc_unused(ring));
+	ixgbevf_alloc_rx_buffers(ring, ixgbevf_rx_refill_count(ring));
 }
 
 #ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
-static void ixgbevf_set_rx_buffer_len(struct ixgbevf_adapter *adapter,
-				      struct ixgbevf_ring *rx_ring)
+/**
+ * ixgbevf_rx_buffer_flags - work out the Rx buffer layout
+ * @adapter: board private structure
+ *
+ * Return: the build_skb and buffer size ring state bits that the current
+ * MTU and legacy-rx setting call for, without touching any ring.
+ **/
+static unsigned long ixgbevf_rx_buffer_flags(struct ixgbevf_adapter *adapter)
 {
 	struct net_device *netdev = adapter->netdev;
 	unsigned int max_frame = netdev->mtu + ETH_HLEN + ETH_FCS_LEN;
 
-	/* set build_skb and buffer size flags */
-	clear_ring_build_skb_enabled(rx_ring);
-	clear_ring_uses_large_buffer(rx_ring);
+	/* Frames that fit in 1K get four buffers per page instead of two.
+	 * There is no room left for build_skb headroom and shared info in
+	 * a 1K slot, so these rings copy the headers like legacy-rx. Add a
+	 * VLAN tag of slack so a stacked tag does not force chaining.
+	 */
+	if (PAGE_SIZE < 8192 &&
+	    max_frame + VLAN_HLEN <= IXGBEVF_RXBUFFER_1024)
+		return BIT(__IXGBEVF_RX_1K_BUFFER);
 
 	if (adapter->flags & IXGBEVF_FLAGS_LEGACY_RX)
-		return;
+		return 0;
 
-	set_ring_build_skb_enabled(rx_ring);
+	if (PAGE_SIZE < 8192 && max_frame > IXGBEVF_MAX_FRAME_BUILD_SKB)
+		return BIT(__IXGBEVF_RX_BUILD_SKB_ENABLED) |
+		       BIT(__IXGBEVF_RX_3K_BUFFER);
 
-	if (PAGE_SIZE < 8192) {
-		if (max_frame <= IXGBEVF_MAX_FRAME_BUILD_SKB)
-			return;
+	return BIT(__IXGBEVF_RX_BUILD_SKB_ENABLED);
+}
 
-		set_ring_uses_large_buffer(rx_ring);
-	}
+static void ixgbevf_set_rx_buffer_len(struct ixgbevf_adapter *adapter,
+				      struct ixgbevf_ring *rx_ring)
+{
+	unsigned long flags = ixgbevf_rx_buffer_flags(adapter);
+
+	/* set build_skb and buffer size flags */
+	assign_bit(__IXGBEVF_RX_BUILD_SKB_ENABLED, &rx_ring->state,
+		   flags & BIT(__IXGBEVF_RX_BUILD_SKB_ENABLED));
+	assign_bit(__IXGBEVF_RX_3K_BUFFER, &rx_ring->state,
+		   flags & BIT(__IXGBEVF_RX_3K_BUFFER));
+	assign_bit(__IXGBEVF_RX_1K_BUFFER, &rx_ring->state,
+		   flags & BIT(__IXGBEVF_RX_1K_BUFFER));
 }
 
 #endif /* HAVE_SWIOTLB_SKIP_CPU_SYNC */
@@ -2588,9 +3370,9 @@ static void ixgbevf_configure_rx(struct ixgbevf_adapter *adapter)
 	if (hw->mac.type >= ixgbe_mac_X550_vf)
 		ixgbevf_setup_vfmrqc(adapter);
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 	ret = hw->mac.ops.set_rlpml(hw, netdev->mtu + ETH_HLEN + ETH_FCS_LEN);
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 	if (ret)
 		DPRINTK(HW, DEBUG, "Failed to set MTU at %d\n", netdev->mtu);
 
@@ -2681,12 +3463,12 @@ static void ixgbevf_vlan_rx_add_vid(struct net_device *netdev, u16 vid)
 #endif /* HAVE_NETDEV_VLAN_FEATURES */
 	int ret_val;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	/* add VID to filter table */
 	ret_val = hw->mac.ops.set_vfta(hw, vid, 0, true, false);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	if (ret_val) {
 		netdev_err(netdev, "VF could not set VLAN %d\n", vid);
@@ -2762,12 +3544,12 @@ static void ixgbevf_vlan_rx_kill_vid(struct net_device *netdev, u16 vid)
 		ixgbevf_irq_enable(adapter);
 #endif
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	/* remove VID from filter table */
 	hw->mac.ops.set_vfta(hw, vid, 0, false, false);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 #ifndef HAVE_VLAN_RX_REGISTER
 	clear_bit(vid, adapter->active_vlans);
@@ -2798,13 +3580,26 @@ static void ixgbevf_restore_vlan(struct ixgbevf_adapter *adapter)
 		}
 	}
 #else /* !HAVE_VLAN_RX_REGISTER */
-	for_each_set_bit(vid, adapter->active_vlans, VLAN_N_VID)
-#ifdef NETIF_F_HW_VLAN_CTAG_RX
-		ixgbevf_vlan_rx_add_vid(adapter->netdev, htons(ETH_P_8021Q),
-					vid);
-#else
-		ixgbevf_vlan_rx_add_vid(adapter->netdev, vid);
-#endif
+	struct ixgbe_hw *hw = &adapter->hw;
+	s32 err = 0, ret;
+
+	/* one mailbox burst, the lock is held until every VID went out */
+	mutex_lock(&adapter->mbx_lock);
+
+	for_each_set_bit(vid, adapter->active_vlans, VLAN_N_VID) {
+		ret = hw->mac.ops.set_vfta(hw, vid, 0, true, false);
+		err = err ? : ret;
+
+		/* the PF stopped answering, the rest would only time out */
+		if (ret < 0)
+			break;
+	}
+
+	mutex_unlock(&adapter->mbx_lock);
+
+	if (err)
+		netdev_err(adapter->netdev,
+			   "VF could not restore all VLAN filters: %d\n", err);
 #endif /* HAVE_VLAN_RX_REGISTER */
 }
 #endif /* NETIF_F_HW_VLAN_TX || NETIF_F_HW_VLAN_CTAG_TX*/
@@ -2812,139 +3607,376 @@ static void ixgbevf_restore_vlan(struct ixgbevf_adapter *adapter)
 static u8 *ixgbevf_addr_list_itr(struct ixgbe_hw __maybe_unused *hw, u8 **mc_addr_ptr,
 				 u32 *vmdq)
 {
-#ifdef NETDEV_HW_ADDR_T_MULTICAST
-	struct netdev_hw_addr *mc_ptr;
-#else
-	struct dev_mc_list *mc_ptr;
-#endif
 	u8 *addr = *mc_addr_ptr;
-	*vmdq = 0;
 
-#ifdef NETDEV_HW_ADDR_T_MULTICAST
-	mc_ptr = container_of(addr, struct netdev_hw_addr, addr[0]);
-	if (mc_ptr->list.next) {
-		struct netdev_hw_addr *ha;
-
-		ha = list_entry(mc_ptr->list.next, struct netdev_hw_addr, list);
-		*mc_addr_ptr = ha->addr;
-	}
-#else
-	mc_ptr = container_of(addr, struct dev_mc_list, dmi_addr[0]);
-	if (mc_ptr->next)
-		*mc_addr_ptr = mc_ptr->next->dmi_addr;
-#endif
-	else
-		*mc_addr_ptr = NULL;
+	/* walks the flat copy made by ixgbevf_sync_rx_mode() */
+	*mc_addr_ptr += ETH_ALEN;
+	*vmdq = 0;
 
 	return addr;
 }
 
 #ifdef NETDEV_HW_ADDR_T_UNICAST
-static int ixgbevf_write_uc_addr_list(struct net_device *netdev)
+/**
+ * ixgbevf_write_uc_addr_list - bring the PF macvlan list up to date
+ * @adapter: board private structure
+ * @uc_list: flat copy of the netdev unicast list
+ * @uc_count: number of addresses in @uc_list
+ *
+ * The PF starts a new list when it sees index 1 and appends on any higher
+ * index, so addresses that were only added behind the ones it already has
+ * are sent on their own.  Everything else rebuilds the list from scratch.
+ *
+ * Return: 0 on success, negative on mailbox failure or when the PF ran out
+ * of filters.
+ **/
+static int ixgbevf_write_uc_addr_list(struct ixgbevf_adapter *adapter,
+				      u8 *uc_list, int uc_count)
 {
-	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
 	struct ixgbe_hw *hw = &adapter->hw;
-	int count = 0;
+	u8 *cache = adapter->rx_mode_uc;
+	int old_count = -1, count = 0;
+	s32 err = 0;
 
-	if (!netdev_uc_empty(netdev)) {
-		struct netdev_hw_addr *ha;
-		netdev_for_each_uc_addr(ha, netdev) {
-			hw->mac.ops.set_uc_addr(hw, ++count, ha->addr);
-			udelay(200);
-		}
-	} else {
-		/*
+	if (adapter->rx_mode_synced)
+		old_count = adapter->rx_mode_uc_count;
+
+	if (uc_count == old_count &&
+	    (!uc_count || !memcmp(cache, uc_list, uc_count * ETH_ALEN)))
+		return 0;
+
+	if (old_count > 0 && uc_count > old_count &&
+	    !memcmp(cache, uc_list, old_count * ETH_ALEN))
+		count = old_count;
+
+	if (uc_count) {
+		for (; count < uc_count; count++) {
+			err = hw->mac.ops.set_uc_addr(hw, count + 1,
+						      uc_list + count * ETH_ALEN);
+			if (err)
+				break;
+			usleep_range(200, 400);
+		}
+	} else {
+		/*
 		 * If the list is empty then send message to PF driver to
 		 * clear all macvlans on this VF.
 		 */
-		hw->mac.ops.set_uc_addr(hw, 0, NULL);
+		err = hw->mac.ops.set_uc_addr(hw, 0, NULL);
 	}
 
-	return count;
+	kfree(adapter->rx_mode_uc);
+	adapter->rx_mode_uc = NULL;
+	adapter->rx_mode_uc_count = 0;
+
+	/* remember what the PF holds, a partial list is resent in full */
+	if (!err && uc_count) {
+		adapter->rx_mode_uc = kmemdup(uc_list, uc_count * ETH_ALEN,
+					      GFP_KERNEL);
+		if (!adapter->rx_mode_uc)
+			return -ENOMEM;
+		adapter->rx_mode_uc_count = uc_count;
+	}
+
+	return err;
 }
 
 #endif
+static int ixgbevf_cmp_mc_hash(const void *a, const void *b)
+{
+	return *(const u16 *)a - *(const u16 *)b;
+}
+
 /**
- * ixgbevf_set_rx_mode - Multicast and unicast set
- * @netdev: network interface device structure
+ * ixgbevf_hash_mc_list - reduce the multicast list to distinct MTA hashes
+ * @hw: pointer to the HW structure
+ * @addrs: flat multicast list, compacted in place to one address per hash
+ * @count: number of addresses in @addrs
+ * @hashes: filled with the sorted distinct hashes
+ * @overflow: set when more hashes exist than one mailbox message carries
  *
- * The set_rx_method entry point is called whenever the multicast address
- * list, unicast address list or the network interface flags are updated.
- * This routine is responsible for configuring the hardware for proper
- * multicast mode and configuring requested unicast filters.
+ * Return: number of hashes stored in @hashes.
  **/
-static void ixgbevf_set_rx_mode(struct net_device *netdev)
+static int ixgbevf_hash_mc_list(struct ixgbe_hw *hw, u8 *addrs, int count,
+				u16 *hashes, bool *overflow)
 {
-	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
+	int i, j, n = 0;
+
+	*overflow = false;
+
+	for (i = 0; i < count; i++) {
+		u8 *addr = addrs + i * ETH_ALEN;
+		u16 hash = ixgbe_mta_vector(hw, addr);
+
+		for (j = 0; j < n; j++)
+			if (hashes[j] == hash)
+				break;
+		if (j < n)
+			continue;
+
+		if (n == IXGBE_VF_MC_HASHES_MAX) {
+			*overflow = true;
+			break;
+		}
+
+		hashes[n] = hash;
+		memmove(addrs + n * ETH_ALEN, addr, ETH_ALEN);
+		n++;
+	}
+
+	sort(hashes, n, sizeof(*hashes), ixgbevf_cmp_mc_hash, NULL);
+
+	return n;
+}
+
+/**
+ * ixgbevf_sync_rx_mode - push the interface filters to the PF
+ * @adapter: board private structure
+ * @force: resend everything, the PF state is unknown
+ *
+ * The address lists are copied under the netdev address lock, the mailbox
+ * messages are sent afterwards from process context since they may sleep.
+ * Unless @force is set, only the parts that differ from what the PF last
+ * acknowledged are sent.
+ *
+ * Multicast addresses are reduced to their MTA hashes.  When more distinct
+ * hashes exist than a single SET_MULTICAST message holds the VF asks for
+ * all-multicast as well, but still programs the truncated list: the PF
+ * quietly downgrades the request to MULTI for an untrusted VF.
+ **/
+static void ixgbevf_sync_rx_mode(struct ixgbevf_adapter *adapter, bool force)
+{
+	u16 mc_hashes[IXGBE_VF_MC_HASHES_MAX];
+	struct net_device *netdev = adapter->netdev;
 	struct ixgbe_hw *hw = &adapter->hw;
-	unsigned int flags = netdev->flags;
+#ifdef NETDEV_HW_ADDR_T_MULTICAST
+	struct netdev_hw_addr *ha;
+#else
+	struct dev_mc_list *ha;
+#endif
+#ifdef NETDEV_HW_ADDR_T_UNICAST
+	struct netdev_hw_addr *uc;
+#endif
+	int mc_count, mc_hash_count, uc_count = 0;
+	bool mc_overflow;
+	u8 *addrs, *addr;
+	unsigned int flags;
 	int xcast_mode;
-	u8 *addr_list = NULL;
-	int addr_count = 0;
+	s32 err = 0;
+
+	netif_addr_lock_bh(netdev);
+
+	flags = netdev->flags;
+	mc_count = netdev_mc_count(netdev);
+#ifdef NETDEV_HW_ADDR_T_UNICAST
+	uc_count = netdev_uc_count(netdev);
+#endif
+	addrs = kcalloc(mc_count + uc_count + 1, ETH_ALEN, GFP_ATOMIC);
+	if (!addrs) {
+		netif_addr_unlock_bh(netdev);
+		return;
+	}
+
+	addr = addrs;
+	netdev_for_each_mc_addr(ha, netdev) {
+#ifdef NETDEV_HW_ADDR_T_MULTICAST
+		ether_addr_copy(addr, ha->addr);
+#else
+		ether_addr_copy(addr, ha->dmi_addr);
+#endif
+		addr += ETH_ALEN;
+	}
+#ifdef NETDEV_HW_ADDR_T_UNICAST
+	netdev_for_each_uc_addr(uc, netdev) {
+		ether_addr_copy(addr, uc->addr);
+		addr += ETH_ALEN;
+	}
+#endif
+
+	netif_addr_unlock_bh(netdev);
+
+	mc_hash_count = ixgbevf_hash_mc_list(hw, addrs, mc_count, mc_hashes,
+					     &mc_overflow);
 
 	/* request the most inclusive mode we need */
 	if (flags & IFF_PROMISC)
 		xcast_mode = IXGBEVF_XCAST_MODE_PROMISC;
-	else if (flags & IFF_ALLMULTI)
+	else if ((flags & IFF_ALLMULTI) || mc_overflow)
 		xcast_mode = IXGBEVF_XCAST_MODE_ALLMULTI;
 	else if (flags & (IFF_BROADCAST | IFF_MULTICAST))
 		xcast_mode = IXGBEVF_XCAST_MODE_MULTI;
 	else
 		xcast_mode = IXGBEVF_XCAST_MODE_NONE;
 
-	/* reprogram multicast list */
-	addr_count = netdev_mc_count(netdev);
-	if (addr_count)
-#ifdef NETDEV_HW_ADDR_T_MULTICAST
-	{
-		struct netdev_hw_addr *ha;
+	mutex_lock(&adapter->mbx_lock);
+
+	force |= !adapter->rx_mode_synced;
+	adapter->rx_mode_synced &= !force;
+	if (force)
+		adapter->rx_mode_xcast = -1;
+
+	if (xcast_mode != adapter->rx_mode_xcast) {
+		err = hw->mac.ops.update_xcast_mode(hw, xcast_mode);
+		if (err == IXGBE_ERR_FEATURE_NOT_SUPPORTED) {
+			/* old API or refused by the PF, not asked again until
+			 * the mode changes or the PF is reset
+			 */
+			if (mc_overflow)
+				netdev_warn(netdev,
+					    "PF refused all-multicast, only %d multicast filters programmed\n",
+					    mc_hash_count);
+			err = 0;
+		}
+		if (err)
+			goto out;
 
-		ha = list_first_entry(&netdev->mc.list,
-			struct netdev_hw_addr, list);
-		addr_list = ha->addr;
+		adapter->rx_mode_xcast = xcast_mode;
 	}
-#else
-		addr_list = netdev->mc_list->dmi_addr;
-#endif
-	spin_lock_bh(&adapter->mbx_lock);
 
-	hw->mac.ops.update_xcast_mode(hw, xcast_mode);
+	/* sent even with ALLMULTI requested, the PF may not have honoured it */
+	if (force || mc_hash_count != adapter->rx_mode_mc_count ||
+	    memcmp(mc_hashes, adapter->rx_mode_mc,
+		   mc_hash_count * sizeof(*mc_hashes))) {
+		err = hw->mac.ops.update_mc_addr_list(hw, addrs, mc_hash_count,
+						      ixgbevf_addr_list_itr,
+						      false);
+		if (err)
+			goto out;
 
-	hw->mac.ops.update_mc_addr_list(hw, addr_list, addr_count,
-					ixgbevf_addr_list_itr, false);
+		memcpy(adapter->rx_mode_mc, mc_hashes,
+		       mc_hash_count * sizeof(*mc_hashes));
+		adapter->rx_mode_mc_count = mc_hash_count;
+	}
 
 #ifdef NETDEV_HW_ADDR_T_UNICAST
-	ixgbevf_write_uc_addr_list(netdev);
+	err = ixgbevf_write_uc_addr_list(adapter, addrs + mc_count * ETH_ALEN,
+					 uc_count);
 #endif
 
-	spin_unlock_bh(&adapter->mbx_lock);
+out:
+	adapter->rx_mode_synced = !err;
+	mutex_unlock(&adapter->mbx_lock);
+
+	if (err)
+		netdev_dbg(netdev, "rx filters not in sync with the PF: %d\n",
+			   err);
+
+	kfree(addrs);
 }
 
-static void ixgbevf_napi_enable_all(struct ixgbevf_adapter *adapter)
+/**
+ * ixgbevf_rx_mode_task - deferred part of ixgbevf_set_rx_mode()
+ * @work: pointer to work_struct containing our data
+ **/
+static void ixgbevf_rx_mode_task(struct work_struct *work)
 {
-	int q_idx;
+	struct ixgbevf_adapter *adapter = container_of(work,
+						       struct ixgbevf_adapter,
+						       rx_mode_task);
+
+	/* the filters are pushed again when the device comes back */
+	if (test_bit(__IXGBEVF_REMOVING, &adapter->state) ||
+	    test_bit(__IXGBEVF_DISABLED, &adapter->state))
+		return;
+
+	ixgbevf_sync_rx_mode(adapter, false);
+}
+
+/**
+ * ixgbevf_set_rx_mode - Multicast and unicast set
+ * @netdev: network interface device structure
+ *
+ * The set_rx_method entry point is called whenever the multicast address
+ * list, unicast address list or the network interface flags are updated.
+ * It runs in atomic context, so the filters are programmed from
+ * ixgbevf_rx_mode_task() where the mailbox may sleep.
+ **/
+static void ixgbevf_set_rx_mode(struct net_device *netdev)
+{
+	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
+
+	schedule_work(&adapter->rx_mode_task);
+}
+
+/**
+ * ixgbevf_fanout_enable - start the fan-out stage before the queue vectors
+ * @adapter: board private structure
+ *
+ * The target CPU list is rebuilt from the online CPUs on every bring-up.
+ **/
+static void ixgbevf_fanout_enable(struct ixgbevf_adapter *adapter)
+{
+	unsigned int cpu, i = 0;
+
+	for_each_online_cpu(cpu)
+		adapter->fanout_cpus[i++] = cpu;
+	adapter->num_fanout_cpus = i;
+
+	for_each_possible_cpu(cpu)
+		napi_enable(&per_cpu_ptr(adapter->rx_fanout, cpu)->napi);
+
+	adapter->fanout_active = true;
+}
 
-	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++) {
+/**
+ * ixgbevf_fanout_disable - stop the fan-out stage after the queue vectors
+ * @adapter: board private structure
+ **/
+static void ixgbevf_fanout_disable(struct ixgbevf_adapter *adapter)
+{
+	unsigned int cpu;
+
+	adapter->fanout_active = false;
+
+	for_each_possible_cpu(cpu) {
+		struct ixgbevf_rx_fanout *fanout =
+			per_cpu_ptr(adapter->rx_fanout, cpu);
+
+		napi_disable(&fanout->napi);
+		skb_queue_purge(&fanout->backlog);
+	}
+}
+
+static void ixgbevf_napi_enable_one(struct ixgbevf_q_vector *q_vector)
+{
 #ifdef HAVE_NDO_BUSY_POLL
-		ixgbevf_qv_init_lock(adapter->q_vector[q_idx]);
+	ixgbevf_qv_init_lock(q_vector);
 #endif
-		napi_enable(&adapter->q_vector[q_idx]->napi);
+	napi_enable(&q_vector->napi);
+}
+
+static void ixgbevf_napi_disable_one(struct ixgbevf_q_vector *q_vector)
+{
+	napi_disable(&q_vector->napi);
+	hrtimer_cancel(&q_vector->poll_timer);
+#ifdef HAVE_NDO_BUSY_POLL
+	while(!ixgbevf_qv_disable(q_vector)) {
+		pr_info("QV %d locked\n", q_vector->v_idx);
+		usleep_range(1000, 20000);
 	}
+#endif /* HAVE_NDO_BUSY_POLL */
+}
+
+static void ixgbevf_napi_enable_all(struct ixgbevf_adapter *adapter)
+{
+	int q_idx;
+
+	if ((adapter->flags & IXGBEVF_FLAG_RX_FANOUT) && adapter->rx_fanout)
+		ixgbevf_fanout_enable(adapter);
+
+	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++)
+		ixgbevf_napi_enable_one(adapter->q_vector[q_idx]);
 }
 
 static void ixgbevf_napi_disable_all(struct ixgbevf_adapter *adapter)
 {
 	int q_idx;
 
-	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++) {
-		napi_disable(&adapter->q_vector[q_idx]->napi);
-#ifdef HAVE_NDO_BUSY_POLL
-		while(!ixgbevf_qv_disable(adapter->q_vector[q_idx])) {
-			pr_info("QV %d locked\n", q_idx);
-			usleep_range(1000, 20000);
-		}
-#endif /* HAVE_NDO_BUSY_POLL */
-	}
+	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++)
+		ixgbevf_napi_disable_one(adapter->q_vector[q_idx]);
+
+	if (adapter->fanout_active)
+		ixgbevf_fanout_disable(adapter);
 }
 
 static int ixgbevf_configure_dcb(struct ixgbevf_adapter *adapter)
@@ -2956,12 +3988,12 @@ static int ixgbevf_configure_dcb(struct ixgbevf_adapter *adapter)
 	unsigned int num_tx_queues = adapter->num_tx_queues;
 	int err;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	/* fetch queue configuration from the PF */
 	err = ixgbevf_get_queues(hw, &num_tcs, &def_q);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	if (err)
 		return err;
@@ -2994,7 +4026,8 @@ static void ixgbevf_configure(struct ixgbevf_adapter *adapter)
 {
 	ixgbevf_configure_dcb(adapter);
 
-	ixgbevf_set_rx_mode(adapter->netdev);
+	/* the PF dropped our filters along with the reset */
+	ixgbevf_sync_rx_mode(adapter, true);
 
 #if defined(NETIF_F_HW_VLAN_TX) || defined(NETIF_F_HW_VLAN_CTAG_TX)
 	ixgbevf_restore_vlan(adapter);
@@ -3079,7 +4112,7 @@ static void ixgbevf_negotiate_api(struct ixgbevf_adapter *adapter)
 		      ixgbe_mbox_api_unknown };
 	int err = 0, idx = 0;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	while (api[idx] != ixgbe_mbox_api_unknown) {
 		err = hw->mac.ops.negotiate_api_version(hw, api[idx]);
@@ -3093,7 +4126,7 @@ static void ixgbevf_negotiate_api(struct ixgbevf_adapter *adapter)
 	if (adapter->pf_features & IXGBEVF_PF_SUP_ESX_MBX)
 		ixgbe_upgrade_mbx_params_vf(hw);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 }
 
 static void ixgbevf_up_complete(struct ixgbevf_adapter *adapter)
@@ -3109,7 +4142,7 @@ static void ixgbevf_up_complete(struct ixgbevf_adapter *adapter)
 #endif
 	ixgbevf_configure_msix(adapter);
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	if (is_valid_ether_addr(hw->mac.addr))
 		hw->mac.ops.set_rar(hw, 0, hw->mac.addr,
@@ -3118,7 +4151,7 @@ static void ixgbevf_up_complete(struct ixgbevf_adapter *adapter)
 		hw->mac.ops.set_rar(hw, 0, hw->mac.perm_addr,
 				0, IXGBE_RAH_AV);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	state = adapter->link_state;
 	hw->mac.ops.get_link_state(hw, &adapter->link_state);
@@ -3133,6 +4166,20 @@ static void ixgbevf_up_complete(struct ixgbevf_adapter *adapter)
 	IXGBE_READ_REG(hw, IXGBE_VTEICR);
 	ixgbevf_irq_enable(adapter);
 
+	/* no queue interrupt will ever kick NAPI, start the pollers here */
+	if (adapter->flags & IXGBEVF_FLAG_IRQ_FREE_POLL) {
+		int q_idx;
+
+		for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++) {
+			struct ixgbevf_q_vector *q_vector =
+				adapter->q_vector[q_idx];
+
+			q_vector->poll_idle = 0;
+			q_vector->poll_backoff = IXGBEVF_POLL_BACKOFF_MIN;
+			napi_schedule(&q_vector->napi);
+		}
+	}
+
 	/* enable transmits */
 	netif_tx_start_all_queues(netdev);
 
@@ -3140,6 +4187,7 @@ static void ixgbevf_up_complete(struct ixgbevf_adapter *adapter)
 	ixgbevf_init_last_counter_stats(adapter);
 
 	hw->mac.get_link_status = 1;
+	set_bit(__IXGBEVF_LINK_EVENT, &adapter->state);
 	mod_timer(&adapter->service_timer, jiffies);
 }
 
@@ -3207,6 +4255,88 @@ static void ixgbevf_clean_rx_ring(struct ixgbevf_ring *rx_ring)
 	rx_ring->next_to_alloc = 0;
 	rx_ring->next_to_clean = 0;
 	rx_ring->next_to_use = 0;
+	clear_bit(__IXGBEVF_RX_PARKED, &rx_ring->state);
+	clear_bit(__IXGBEVF_RX_TRIMMED, &rx_ring->state);
+}
+
+/**
+ * ixgbevf_rx_layout_unchanged - check if parked pages fit the next bring-up
+ * @adapter: board private structure
+ * @rx_ring: ring about to be parked
+ *
+ * The page order and buffer offsets depend on the MTU and the legacy-rx
+ * flag, both of which may have changed right before a reinit.
+ **/
+static bool ixgbevf_rx_layout_unchanged(struct ixgbevf_adapter *adapter,
+					struct ixgbevf_ring *rx_ring)
+{
+#ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
+	const unsigned long mask = BIT(__IXGBEVF_RX_3K_BUFFER) |
+				   BIT(__IXGBEVF_RX_1K_BUFFER) |
+				   BIT(__IXGBEVF_RX_BUILD_SKB_ENABLED);
+
+	return !((READ_ONCE(rx_ring->state) ^
+		  ixgbevf_rx_buffer_flags(adapter)) & mask);
+#else
+	return true;
+#endif /* HAVE_SWIOTLB_SKIP_CPU_SYNC */
+}
+
+/**
+ * ixgbevf_park_rx_ring - keep a stopped ring's mapped pages for a restart
+ * @adapter: board private structure
+ * @rx_ring: ring to park, its queue must already be disabled
+ *
+ * Rotates the posted buffers to the start of rx_buffer_info so that
+ * ixgbevf_configure_rx_ring() can re-post them from descriptor 0 without
+ * allocating or mapping anything. Falls back to a full clean when the
+ * buffer layout is about to change.
+ **/
+static void ixgbevf_park_rx_ring(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *rx_ring)
+{
+	struct ixgbevf_rx_buffer *bi = rx_ring->rx_buffer_info;
+	u16 ntc = rx_ring->next_to_clean;
+	u16 count = rx_ring->count;
+	u16 kept, lo, hi;
+
+	if (!ixgbevf_rx_layout_unchanged(adapter, rx_ring)) {
+		ixgbevf_clean_rx_ring(rx_ring);
+		return;
+	}
+
+	if (rx_ring->skb) {
+		dev_kfree_skb(rx_ring->skb);
+		rx_ring->skb = NULL;
+	}
+
+	kept = rx_ring->next_to_alloc >= ntc ?
+	       rx_ring->next_to_alloc - ntc :
+	       rx_ring->next_to_alloc + count - ntc;
+
+	/* rotate left by ntc: reverse both halves, then the whole array */
+	for (lo = 0, hi = ntc; lo + 1 < hi; lo++, hi--)
+		swap(bi[lo], bi[hi - 1]);
+	for (lo = ntc, hi = count; lo + 1 < hi; lo++, hi--)
+		swap(bi[lo], bi[hi - 1]);
+	for (lo = 0, hi = count; lo + 1 < hi; lo++, hi--)
+		swap(bi[lo], bi[hi - 1]);
+
+	rx_ring->next_to_clean = 0;
+	rx_ring->next_to_use = kept;
+	rx_ring->next_to_alloc = kept;
+	set_bit(__IXGBEVF_RX_PARKED, &rx_ring->state);
+
+	/* every parked page has to be posted again, lift any trim */
+	clear_bit(__IXGBEVF_RX_TRIMMED, &rx_ring->state);
+}
+
+static void ixgbevf_park_all_rx_rings(struct ixgbevf_adapter *adapter)
+{
+	int i;
+
+	for (i = 0; i < adapter->num_rx_queues; i++)
+		ixgbevf_park_rx_ring(adapter, adapter->rx_ring[i]);
 }
 
 /**
@@ -3352,7 +4482,10 @@ void ixgbevf_down(struct ixgbevf_adapter *adapter)
 		ixgbevf_reset(adapter);
 
 	ixgbevf_clean_all_tx_rings(adapter);
-	ixgbevf_clean_all_rx_rings(adapter);
+	if (test_bit(__IXGBEVF_WARM_RESTART, &adapter->state))
+		ixgbevf_park_all_rx_rings(adapter);
+	else
+		ixgbevf_clean_all_rx_rings(adapter);
 }
 
 void ixgbevf_reinit_locked(struct ixgbevf_adapter *adapter)
@@ -3362,9 +4495,12 @@ void ixgbevf_reinit_locked(struct ixgbevf_adapter *adapter)
 	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
 		msleep(1);
 
+	/* keep the Rx pages mapped, ixgbevf_up() re-posts them */
+	set_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
 	ixgbevf_down(adapter);
 	pci_set_master(adapter->pdev);
 	ixgbevf_up(adapter);
+	clear_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
 
 	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
 }
@@ -3424,9 +4560,79 @@ static int ixgbevf_acquire_msix_vectors(struct ixgbevf_adapter *adapter,
 	 */
 	adapter->num_q_vectors = vectors - NON_Q_VECTORS;
 
+	/* the mailbox takes the last entry, so the queue vectors can later
+	 * be shrunk and grown again below it without moving it
+	 */
+	adapter->other_vector = adapter->num_q_vectors;
+
 	return 0;
 }
 
+/**
+ * ixgbevf_max_rss_queues - upper bound for the number of RSS queues
+ * @adapter: board private structure
+ *
+ * The PF reports how many queues it granted this VF through
+ * IXGBE_VF_GET_QUEUES. On top of that, 82599 and X540 VFs can only learn
+ * their redirection table through the mailbox, where the PF packs each
+ * entry into 2 bits, which limits them to 4 queues. X550 and later program
+ * an 8-bit VFRETA directly. There is no point in having more queues than
+ * CPUs either.
+ *
+ * Return: the number of RSS queues the VF should use.
+ */
+u16 ixgbevf_max_rss_queues(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	u16 rss = IXGBEVF_MAX_RSS_QUEUES;
+
+	if (hw->mac.type < ixgbe_mac_X550_vf)
+		rss = IXGBEVF_82599_MAX_RSS_QUEUES;
+
+	rss = min_t(u16, rss, hw->mac.max_rx_queues);
+	rss = min_t(u16, rss, hw->mac.max_tx_queues);
+
+	return min_t(u16, rss, num_online_cpus());
+}
+
+/**
+ * ixgbevf_max_channels - upper bound for the number of queue pairs
+ * @adapter: board private structure
+ *
+ * Applies the limits of ixgbevf_set_num_queues() on top of
+ * ixgbevf_max_rss_queues(). XDP needs a Tx queue of its own for every Rx
+ * queue, and the queue count is not up to the VF at all when the PF uses
+ * traffic classes or only speaks mailbox API 1.0.
+ *
+ * Return: the largest count ixgbevf_set_queue_count() can honour.
+ **/
+u16 ixgbevf_max_channels(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	u16 rss = ixgbevf_max_rss_queues(adapter);
+
+	if (adapter->num_tcs > 1)
+		return 1;
+
+	switch (hw->api_version) {
+	case ixgbe_mbox_api_11:
+	case ixgbe_mbox_api_12:
+	case ixgbe_mbox_api_13:
+	case ixgbe_mbox_api_15:
+	case ixgbe_mbox_api_16:
+	case ixgbe_mbox_api_17:
+		break;
+	default:
+		return 1;
+	}
+
+	/* XDP needs a Tx queue of its own for every Rx queue */
+	if (adapter->xdp_prog)
+		rss = clamp_t(u16, hw->mac.max_tx_queues / 2, 1, rss);
+
+	return rss;
+}
+
 /**
  * ixgbevf_set_num_queues - Allocate queues for device, feature dependent
  * @adapter: board private structure to initialize
@@ -3450,21 +4656,26 @@ static void ixgbevf_set_num_queues(struct ixgbevf_adapter *adapter)
 	adapter->num_tx_queues = 1;
 	adapter->num_xdp_queues = 0;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	/* fetch queue configuration from the PF */
 	err = ixgbevf_get_queues(hw, &num_tcs, &def_q);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	if (err)
 		return;
 
+	adapter->num_tcs = num_tcs;
+
 	/* we need as many queues as traffic classes */
 	if (num_tcs > 1) {
 		adapter->num_rx_queues = num_tcs;
 	} else {
-		u16 rss = min_t(u16, num_online_cpus(), IXGBEVF_MAX_RSS_QUEUES);
+		u16 rss = ixgbevf_max_channels(adapter);
+
+		if (adapter->num_req_queues)
+			rss = min_t(u16, rss, adapter->num_req_queues);
 
 		switch (hw->api_version) {
 		case ixgbe_mbox_api_11:
@@ -3473,10 +4684,6 @@ static void ixgbevf_set_num_queues(struct ixgbevf_adapter *adapter)
 		case ixgbe_mbox_api_15:
 		case ixgbe_mbox_api_16:
 		case ixgbe_mbox_api_17:
-			if (adapter->xdp_prog &&
-			    hw->mac.max_tx_queues == rss)
-				rss = 1;
-
 			adapter->num_rx_queues = rss;
 #ifdef HAVE_TX_MQ
 			adapter->num_tx_queues = rss;
@@ -3489,15 +4696,14 @@ static void ixgbevf_set_num_queues(struct ixgbevf_adapter *adapter)
 }
 
 /**
- * ixgbevf_set_interrupt_capability - set MSI-X or FAIL if not supported
- * @adapter: board private structure to initialize
+ * ixgbevf_q_vector_budget - number of queue vectors worth asking for
+ * @adapter: board private structure
  *
- * Attempt to configure the interrupts using the best available
- * capabilities of the hardware and the kernel.
- */
-static int ixgbevf_set_interrupt_capability(struct ixgbevf_adapter *adapter)
+ * Return: one vector per queue pair, but no more than there are CPUs.
+ **/
+static int ixgbevf_q_vector_budget(struct ixgbevf_adapter *adapter)
 {
-	int vector, v_budget;
+	int v_budget;
 
 	/* It's easy to be greedy for MSI-X vectors, but it really
 	 * doesn't do us much good if we have a lot more vectors
@@ -3506,8 +4712,24 @@ static int ixgbevf_set_interrupt_capability(struct ixgbevf_adapter *adapter)
 	 * The default is to use pairs of vectors.
 	 */
 	v_budget = max(adapter->num_rx_queues, adapter->num_tx_queues);
-	v_budget = min_t(int, v_budget, num_online_cpus());
-	v_budget += NON_Q_VECTORS;
+
+	return min_t(int, v_budget, num_online_cpus());
+}
+
+/**
+ * ixgbevf_set_interrupt_capability - set MSI-X or FAIL if not supported
+ * @adapter: board private structure to initialize
+ *
+ * Attempt to configure the interrupts using the best available
+ * capabilities of the hardware and the kernel.
+ *
+ * Return: 0 on success, negative on failure.
+ **/
+static int ixgbevf_set_interrupt_capability(struct ixgbevf_adapter *adapter)
+{
+	int vector, v_budget;
+
+	v_budget = ixgbevf_q_vector_budget(adapter) + NON_Q_VECTORS;
 
 	adapter->msix_entries = kcalloc(v_budget,
 					sizeof(struct msix_entry), GFP_KERNEL);
@@ -3551,26 +4773,42 @@ static int ixgbevf_alloc_q_vector(struct ixgbevf_adapter *adapter, int v_idx,
 				  int xdp_count, int xdp_idx,
 				  int rxr_count, int rxr_idx)
 {
+	int node = dev_to_node(&adapter->pdev->dev);
 	struct ixgbevf_q_vector *q_vector;
 	int reg_idx = txr_idx + xdp_idx;
 	struct ixgbevf_ring *ring;
 	int ring_count, size;
+	int cpu;
 
 	ring_count = txr_count + xdp_count + rxr_count;
 	size = sizeof(*q_vector) + (sizeof(*ring) * ring_count);
 
-	/* allocate q_vector and rings */
-	q_vector = kzalloc(size, GFP_KERNEL);
+	/* spread the vectors over the CPUs local to the device first */
+	cpu = cpumask_local_spread(v_idx, node);
+	node = cpu_to_node(cpu);
+
+	/* allocate q_vector and rings on the node of that CPU */
+	q_vector = kzalloc_node(size, GFP_KERNEL, node);
+	if (!q_vector)
+		q_vector = kzalloc(size, GFP_KERNEL);
 	if (!q_vector)
 		return -ENOMEM;
 
+	q_vector->numa_node = node;
+	u64_stats_init(&q_vector->poll_stats.syncp);
+
 	/* initialize NAPI */
 	netif_napi_add(adapter->netdev, &q_vector->napi, ixgbevf_poll);
+	hrtimer_setup(&q_vector->poll_timer, ixgbevf_poll_timer,
+		      CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 
 	/* tie q_vector and adapter together */
 	adapter->q_vector[v_idx] = q_vector;
 	q_vector->adapter = adapter;
 	q_vector->v_idx = v_idx;
+#ifdef HAVE_IRQ_AFFINITY_HINT
+	cpumask_set_cpu(cpu, &q_vector->affinity_mask);
+#endif
 
 	/* initialize pointer to rings */
 	ring = q_vector->ring;
@@ -3762,6 +5000,8 @@ static int ixgbevf_alloc_q_vectors(struct ixgbevf_adapter *adapter)
 		xdp_idx += xqpv;
 	}
 
+	ixgbevf_autotune_reset(adapter);
+
 	return 0;
 
 err_out:
@@ -3789,6 +5029,7 @@ static void ixgbevf_free_q_vectors(struct ixgbevf_adapter *adapter)
 	int v_idx = adapter->num_q_vectors;
 
 	adapter->num_tx_queues = 0;
+	adapter->num_xdp_queues = 0;
 	adapter->num_rx_queues = 0;
 	adapter->num_q_vectors = 0;
 
@@ -3905,10 +5146,12 @@ static int __devinit ixgbevf_sw_init(struct ixgbevf_adapter *adapter)
 	case IXGBE_DEV_ID_X550EM_X_VF_HV:
 	case IXGBE_DEV_ID_X550EM_A_VF_HV:
 		ixgbevf_hv_init_ops_vf(hw);
+		adapter->flags |= IXGBEVF_FLAG_HYPERV;
 		break;
 	case IXGBE_DEV_ID_E610_VF:
 		if (hw->subsystem_device_id == IXGBE_SUBDEV_ID_E610_VF_HV) {
 			ixgbevf_hv_init_ops_e6xx_vf(hw);
+			adapter->flags |= IXGBEVF_FLAG_HYPERV;
 			break;
 		}
 		fallthrough;
@@ -3931,8 +5174,11 @@ static int __devinit ixgbevf_sw_init(struct ixgbevf_adapter *adapter)
 	hw->mac.max_tx_queues = 2;
 	hw->mac.max_rx_queues = 2;
 
-	/* lock to protect mailbox accesses */
-	spin_lock_init(&adapter->mbx_lock);
+	/* lock to protect mailbox accesses, the holder may sleep */
+	mutex_init(&adapter->mbx_lock);
+	init_waitqueue_head(&adapter->mbx_wq);
+	hw->mbx.wait = ixgbevf_mbx_wait;
+	hw->mbx.trace = ixgbevf_mbx_trace;
 
 	err = hw->mac.ops.reset_hw(hw);
 	if (err) {
@@ -3969,6 +5215,8 @@ static int __devinit ixgbevf_sw_init(struct ixgbevf_adapter *adapter)
 	/* set default ring sizes */
 	adapter->tx_ring_count = IXGBEVF_DEFAULT_TXD;
 	adapter->rx_ring_count = IXGBEVF_DEFAULT_RXD;
+	adapter->tx_ring_max = IXGBEVF_MAX_NUM_DESCRIPTORS;
+	adapter->rx_ring_max = IXGBEVF_MAX_NUM_DESCRIPTORS;
 
 	/* enable rx csum by default */
 	adapter->flags |= IXGBE_FLAG_RX_CSUM_ENABLED;
@@ -3978,6 +5226,7 @@ static int __devinit ixgbevf_sw_init(struct ixgbevf_adapter *adapter)
 
 	adapter->irqs_ready = false;
 	adapter->link_state = true;
+	adapter->ring_migrate_next = jiffies;
 
 	set_bit(__IXGBEVF_DOWN, &adapter->state);
 
@@ -4016,6 +5265,10 @@ void ixgbevf_update_stats(struct ixgbevf_adapter *adapter)
 	u64 restart_queue = 0, tx_busy = 0;
 	u64 alloc_rx_page_failed = 0, alloc_rx_buff_failed = 0;
 	u64 alloc_rx_page = 0, hw_csum_rx_error = 0;
+	u64 napi_polls = 0, napi_repolls = 0, tx_clean_limited = 0;
+	u64 rx_budget_rebalanced = 0, xdp_clean_deferred = 0;
+	u64 rx_fanout_ipis = 0, rx_fanout_dropped = 0;
+	unsigned int cpu;
 	int i;
 
 	if (test_bit(__IXGBEVF_DOWN, &adapter->state) ||
@@ -4057,6 +5310,46 @@ void ixgbevf_update_stats(struct ixgbevf_adapter *adapter)
 	}
 	adapter->restart_queue = restart_queue;
 	adapter->tx_busy = tx_busy;
+
+	for (i = 0; i < adapter->num_q_vectors; i++) {
+		struct ixgbevf_poll_stats *poll_stats =
+			&adapter->q_vector[i]->poll_stats;
+		u64 polls, repolls, tx_limited, rx_rebalanced, xdp_deferred;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin(&poll_stats->syncp);
+			polls = poll_stats->polls;
+			repolls = poll_stats->repolls;
+			tx_limited = poll_stats->tx_limited;
+			rx_rebalanced = poll_stats->rx_rebalanced;
+			xdp_deferred = poll_stats->xdp_deferred;
+		} while (u64_stats_fetch_retry(&poll_stats->syncp, start));
+
+		napi_polls += polls;
+		napi_repolls += repolls;
+		tx_clean_limited += tx_limited;
+		rx_budget_rebalanced += rx_rebalanced;
+		xdp_clean_deferred += xdp_deferred;
+	}
+	adapter->napi_polls = napi_polls;
+	adapter->napi_repolls = napi_repolls;
+	adapter->tx_clean_limited = tx_clean_limited;
+	adapter->rx_budget_rebalanced = rx_budget_rebalanced;
+	adapter->xdp_clean_deferred = xdp_clean_deferred;
+
+	if (!adapter->rx_fanout)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ixgbevf_rx_fanout *fanout =
+			per_cpu_ptr(adapter->rx_fanout, cpu);
+
+		rx_fanout_ipis += atomic64_read(&fanout->ipis);
+		rx_fanout_dropped += fanout->dropped;
+	}
+	adapter->rx_fanout_ipis = rx_fanout_ipis;
+	adapter->rx_fanout_dropped = rx_fanout_dropped;
 }
 
 /**
@@ -4136,8 +5429,37 @@ static void ixgbevf_check_hang_subtask(struct ixgbevf_adapter *adapter)
 }
 
 /**
- * ixgbevf_watchdog_update_link - update the link status
+ * ixgbevf_pf_msg_pending - check whether the PF sent a notification
  * @adapter: pointer to the device adapter structure
+ *
+ * Replies to our own requests are consumed by whoever sent them, with
+ * adapter->mbx_lock held. A message still waiting once we hold the lock
+ * was therefore sent by the PF on its own, and so was anything the shared
+ * code flagged in hw->mbx.pf_msg while reading or flushing the mailbox.
+ **/
+static bool ixgbevf_pf_msg_pending(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	bool pending;
+
+	if (adapter->flags & IXGBEVF_FLAG_HYPERV)
+		return false;
+
+	mutex_lock(&adapter->mbx_lock);
+	pending = hw->mbx.pf_msg || !hw->mbx.ops[0].check_for_msg(hw, 0);
+	hw->mbx.pf_msg = false;
+	mutex_unlock(&adapter->mbx_lock);
+
+	return pending;
+}
+
+/**
+ * ixgbevf_watchdog_update_link - update the link status
+ * @adapter: pointer to the device adapter structure
+ *
+ * The cached link state is trusted until a mailbox interrupt reports PF
+ * activity.  Otherwise only a link that is down, or IXGBEVF_LINK_CHECK_INTERVAL
+ * without any event, sends us back to the PF on a service pass.
  **/
 static void ixgbevf_watchdog_update_link(struct ixgbevf_adapter *adapter)
 {
@@ -4146,11 +5468,23 @@ static void ixgbevf_watchdog_update_link(struct ixgbevf_adapter *adapter)
 	bool link_up = adapter->link_up;
 	s32 err;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	if (ixgbevf_pf_msg_pending(adapter))
+		set_bit(__IXGBEVF_LINK_EVENT, &adapter->state);
+
+	/* Hyper-V VFs have no PF mailbox to raise events, keep polling */
+	if (!test_and_clear_bit(__IXGBEVF_LINK_EVENT, &adapter->state) &&
+	    link_up && !(adapter->flags & IXGBEVF_FLAG_HYPERV) &&
+	    time_before(jiffies,
+			adapter->link_check + IXGBEVF_LINK_CHECK_INTERVAL))
+		return;
+
+	adapter->link_check = jiffies;
+
+	mutex_lock(&adapter->mbx_lock);
 
 	err = hw->mac.ops.check_link(hw, &link_speed, &link_up, false);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	/* if check for link returns error we will need to reset */
 	if (err && time_after(jiffies, adapter->last_reset + (10 * HZ))) {
@@ -4268,9 +5602,13 @@ static void ixgbevf_service_task(struct work_struct *work)
 	}
 
 	ixgbevf_queue_reset_subtask(adapter);
+	ixgbevf_ring_migrate_subtask(adapter);
+	ixgbevf_ring_restart_subtask(adapter);
 	ixgbevf_reset_subtask(adapter);
 	ixgbevf_watchdog_subtask(adapter);
 	ixgbevf_check_hang_subtask(adapter);
+	ixgbevf_ring_autotune_subtask(adapter);
+	ixgbevf_rx_reclaim_subtask(adapter);
 
 	ixgbevf_service_event_complete(adapter);
 }
@@ -4317,180 +5655,1317 @@ static void ixgbevf_free_all_tx_resources(struct ixgbevf_adapter *adapter)
 }
 
 /**
- * ixgbevf_setup_tx_resources - allocate Tx resources (Descriptors)
- * @tx_ring: tx descriptor ring (for a specific queue) to setup
+ * ixgbevf_alloc_desc_node - allocate descriptor memory on a given node
+ * @ring: ring the descriptors are for, ring->size must already be set
+ * @dma: returns the bus address of the allocation
+ * @node: preferred NUMA node, NUMA_NO_NODE for the device's own node
+ *
+ * dma_alloc_coherent() allocates on the node of the device, so point the
+ * device at @node for the duration of the call. If that fails fall back to
+ * the device's node.
+ *
+ * Return: descriptor memory or NULL on failure.
+ */
+static void *ixgbevf_alloc_desc_node(struct ixgbevf_ring *ring,
+				     dma_addr_t *dma, int node)
+{
+	struct device *dev = ring->dev;
+	int orig_node = dev_to_node(dev);
+	void *desc;
+
+	set_dev_node(dev, node);
+	desc = dma_alloc_coherent(dev, ring->size, dma, GFP_KERNEL);
+	set_dev_node(dev, orig_node);
+	if (!desc)
+		desc = dma_alloc_coherent(dev, ring->size, dma, GFP_KERNEL);
+
+	return desc;
+}
+
+/**
+ * ixgbevf_setup_tx_resources - allocate Tx resources (Descriptors)
+ * @tx_ring: tx descriptor ring (for a specific queue) to setup
+ *
+ * Return 0 on success, negative on failure
+ **/
+int ixgbevf_setup_tx_resources(struct ixgbevf_ring *tx_ring)
+{
+	int node = tx_ring->q_vector ?
+		   READ_ONCE(tx_ring->q_vector->numa_node) : NUMA_NO_NODE;
+	int size;
+
+	size = sizeof(struct ixgbevf_tx_buffer) * tx_ring->count;
+	tx_ring->tx_buffer_info = vmalloc_node(size, node);
+	if (!tx_ring->tx_buffer_info)
+		tx_ring->tx_buffer_info = vmalloc(size);
+	if (!tx_ring->tx_buffer_info)
+		goto err;
+
+	u64_stats_init(&tx_ring->syncp);
+
+	/* round up to nearest 4K */
+	tx_ring->size = tx_ring->count * sizeof(union ixgbe_adv_tx_desc);
+	tx_ring->size = ALIGN(tx_ring->size, 4096);
+
+	tx_ring->desc = ixgbevf_alloc_desc_node(tx_ring, &tx_ring->dma, node);
+	if (!tx_ring->desc)
+		goto err;
+
+	tx_ring->numa_node = node;
+
+	return 0;
+
+err:
+	vfree(tx_ring->tx_buffer_info);
+	tx_ring->tx_buffer_info = NULL;
+	dev_err(tx_ring->dev, "Unable to allocate memory for the Tx descriptor ring\n");
+	return -ENOMEM;
+}
+
+/**
+ * ixgbevf_setup_all_tx_resources - allocate all queues Tx resources
+ * @adapter: board private structure
+ *
+ * If this function returns with an error, then it's possible one or
+ * more of the rings is populated (while the rest are not).  It is the
+ * callers duty to clean those orphaned rings.
+ *
+ * Return 0 on success, negative on failure
+ **/
+static int ixgbevf_setup_all_tx_resources(struct ixgbevf_adapter *adapter)
+{
+	int i, j = 0, err = 0;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		err = ixgbevf_setup_tx_resources(adapter->tx_ring[i]);
+		if (!err)
+			continue;
+		DPRINTK(PROBE, ERR, "Allocation for Tx Queue %u failed\n", i);
+		goto err_setup_tx;
+	}
+
+	for (j = 0; j < adapter->num_xdp_queues; j++) {
+		err = ixgbevf_setup_tx_resources(adapter->xdp_ring[j]);
+		if (!err)
+			continue;
+		hw_dbg(&adapter->hw, "Allocation for XDP Queue %u failed\n", j);
+		goto err_setup_tx;
+	}
+
+	return 0;
+err_setup_tx:
+	/* rewind the index freeing the rings as we go */
+	while (j--)
+		ixgbevf_free_tx_resources(adapter->xdp_ring[j]);
+	while (i--)
+		ixgbevf_free_tx_resources(adapter->tx_ring[i]);
+
+	return err;
+}
+
+/**
+ * ixgbevf_setup_rx_resources - allocate Rx resources (Descriptors)
+ * @adapter: board private structure
+ * @rx_ring: Rx descriptor ring (for a specific queue) to setup
+ *
+ * Returns 0 on success, negative on failure
+ **/
+int ixgbevf_setup_rx_resources(struct ixgbevf_adapter *adapter,
+			       struct ixgbevf_ring *rx_ring)
+{
+	int node = rx_ring->q_vector ?
+		   READ_ONCE(rx_ring->q_vector->numa_node) : NUMA_NO_NODE;
+	int size;
+
+	size = sizeof(struct ixgbevf_rx_buffer) * rx_ring->count;
+	rx_ring->rx_buffer_info = vmalloc_node(size, node);
+	if (!rx_ring->rx_buffer_info)
+		rx_ring->rx_buffer_info = vmalloc(size);
+	if (!rx_ring->rx_buffer_info)
+		goto err;
+
+	u64_stats_init(&rx_ring->syncp);
+
+	/* Round up to nearest 4K */
+	rx_ring->size = rx_ring->count * sizeof(union ixgbe_adv_rx_desc);
+	rx_ring->size = ALIGN(rx_ring->size, 4096);
+
+	rx_ring->desc = ixgbevf_alloc_desc_node(rx_ring, &rx_ring->dma, node);
+
+	if (!rx_ring->desc)
+		goto err;
+
+	rx_ring->numa_node = node;
+
+#ifdef HAVE_XDP_BUFF_RXQ
+	/* XDP RX-queue info */
+	if (xdp_rxq_info_reg(&rx_ring->xdp_rxq, adapter->netdev,
+			     rx_ring->queue_index, 0) < 0)
+		goto err;
+
+#endif /* HAVE_XDP_BUFF_RXQ */
+	rx_ring->xdp_prog = adapter->xdp_prog;
+
+	return 0;
+err:
+	vfree(rx_ring->rx_buffer_info);
+	rx_ring->rx_buffer_info = NULL;
+	dev_err(rx_ring->dev, "Unable to allocate memory for the Rx descriptor ring\n");
+	return -ENOMEM;
+}
+
+/**
+ * ixgbevf_setup_all_rx_resources - allocate all queues Rx resources
+ * @adapter: board private structure
+ *
+ * If this function returns with an error, then it's possible one or
+ * more of the rings is populated (while the rest are not).  It is the
+ * callers duty to clean those orphaned rings.
+ *
+ * Return 0 on success, negative on failure
+ **/
+static int ixgbevf_setup_all_rx_resources(struct ixgbevf_adapter *adapter)
+{
+	int i, err = 0;
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		err = ixgbevf_setup_rx_resources(adapter, adapter->rx_ring[i]);
+		if (!err)
+			continue;
+		DPRINTK(PROBE, ERR, "Allocation for Rx Queue %u failed\n", i);
+		goto err_setup_rx;
+	}
+
+	return 0;
+err_setup_rx:
+	/* rewind the index freeing the rings as we go */
+	while (i--)
+		ixgbevf_free_rx_resources(adapter->rx_ring[i]);
+	return err;
+}
+
+/**
+ * ixgbevf_free_rx_resources - Free Rx Resources
+ * @rx_ring: ring to clean the resources from
+ *
+ * Free all receive software resources
+ **/
+void ixgbevf_free_rx_resources(struct ixgbevf_ring *rx_ring)
+{
+	ixgbevf_clean_rx_ring(rx_ring);
+
+	rx_ring->xdp_prog = NULL;
+#ifdef HAVE_XDP_BUFF_RXQ
+	xdp_rxq_info_unreg(&rx_ring->xdp_rxq);
+#endif /* HAVE_XDP_BUFF_RXQ */
+	vfree(rx_ring->rx_buffer_info);
+	rx_ring->rx_buffer_info = NULL;
+
+	dma_free_coherent(rx_ring->dev, rx_ring->size,
+			  rx_ring->desc, rx_ring->dma);
+
+	rx_ring->desc = NULL;
+}
+
+/**
+ * ixgbevf_take_ring_resources - move descriptor memory from a ring clone
+ * @ring: ring whose previous resources have already been freed
+ * @new: clone set up by ixgbevf_setup_{tx,rx}_resources
+ **/
+static void ixgbevf_take_ring_resources(struct ixgbevf_ring *ring,
+					struct ixgbevf_ring *new)
+{
+	ring->desc = new->desc;
+	ring->dma = new->dma;
+	ring->size = new->size;
+	ring->count = new->count;
+	ring->numa_node = new->numa_node;
+	ring->tx_buffer_info = new->tx_buffer_info;
+	ring->xdp_prog = new->xdp_prog;
+#ifdef HAVE_XDP_BUFF_RXQ
+	ring->xdp_rxq = new->xdp_rxq;
+#endif
+}
+
+/**
+ * ixgbevf_restart_q_vector - resume a vector paused for a single ring
+ * @q_vector: vector to restart
+ *
+ * Its interrupt may have fired while NAPI was disabled, so poll it once to
+ * pick up pending work and re-arm the interrupt.
+ **/
+static void ixgbevf_restart_q_vector(struct ixgbevf_q_vector *q_vector)
+{
+	ixgbevf_napi_enable_one(q_vector);
+	napi_schedule(&q_vector->napi);
+}
+
+/**
+ * ixgbevf_tx_queue_stop - stop the netdev queue backed by a single ring
+ * @ring: Tx ring, XDP rings are only fed from NAPI and are left alone
+ *
+ * The ring is marked __IXGBEVF_TX_STOPPED before the queue is stopped, so
+ * that neither ixgbevf_clean_tx_irq() nor a racing transmit can start it
+ * again while its vector keeps draining the descriptors already posted.
+ **/
+static void ixgbevf_tx_queue_stop(struct ixgbevf_ring *ring)
+{
+	struct netdev_queue *txq;
+
+	set_bit(__IXGBEVF_TX_STOPPED, &ring->state);
+	if (ring_is_xdp(ring))
+		return;
+
+	/* pairs with the smp_mb() before the wake check in clean_tx_irq */
+	smp_mb__after_atomic();
+
+	txq = txring_txq(ring);
+	__netif_tx_lock_bh(txq);
+	netif_tx_stop_queue(txq);
+	__netif_tx_unlock_bh(txq);
+}
+
+/**
+ * ixgbevf_tx_ring_stop - quiesce a single Tx or XDP ring
+ * @adapter: board private structure
+ * @ring: ring to stop
+ *
+ * Stops the netdev queue backed by @ring, pauses its vector and halts the
+ * hardware queue. Other rings keep running, apart from those sharing the
+ * paused vector. Nothing is done while the interface is down.
+ **/
+static void ixgbevf_tx_ring_stop(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *ring)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	ixgbevf_tx_queue_stop(ring);
+	ixgbevf_napi_disable_one(ring->q_vector);
+
+	/* stop DMA before the descriptors are touched */
+	IXGBE_WRITE_REG(hw, IXGBE_VFTXDCTL(ring->reg_idx),
+			IXGBE_TXDCTL_SWFLSH);
+	IXGBE_WRITE_FLUSH(hw);
+}
+
+/**
+ * ixgbevf_tx_ring_start - restart a ring stopped by ixgbevf_tx_ring_stop
+ * @adapter: board private structure
+ * @ring: ring to start, its software state is reset
+ **/
+static void ixgbevf_tx_ring_start(struct ixgbevf_adapter *adapter,
+				  struct ixgbevf_ring *ring)
+{
+	clear_bit(__IXGBEVF_TX_STOPPED, &ring->state);
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	ixgbevf_configure_tx_ring(adapter, ring);
+	ixgbevf_restart_q_vector(ring->q_vector);
+
+	if (!ring_is_xdp(ring))
+		netif_tx_wake_queue(txring_txq(ring));
+}
+
+/**
+ * ixgbevf_rx_ring_stop - quiesce a single Rx ring
+ * @adapter: board private structure
+ * @ring: ring to stop
+ *
+ * Frames arriving while the queue is disabled are dropped by the hardware
+ * for this queue alone. Nothing is done while the interface is down.
+ **/
+static void ixgbevf_rx_ring_stop(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *ring)
+{
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	ixgbevf_napi_disable_one(ring->q_vector);
+	ixgbevf_disable_rx_queue(adapter, ring);
+}
+
+/**
+ * ixgbevf_rx_ring_start - restart a ring stopped by ixgbevf_rx_ring_stop
+ * @adapter: board private structure
+ * @ring: ring to start, it is refilled from scratch
+ **/
+static void ixgbevf_rx_ring_start(struct ixgbevf_adapter *adapter,
+				  struct ixgbevf_ring *ring)
+{
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	ixgbevf_configure_rx_ring(adapter, ring);
+	ixgbevf_restart_q_vector(ring->q_vector);
+}
+
+/**
+ * ixgbevf_swap_tx_ring - move a live Tx or XDP ring onto new resources
+ * @adapter: board private structure
+ * @ring: ring in use by the hardware
+ * @new: clone of @ring holding the new descriptors, consumed on return
+ *
+ * Descriptors already posted are given IXGBEVF_TX_DRAIN_TIMEOUT_MS to
+ * complete; anything left after that is dropped when the old ring is freed.
+ **/
+static void ixgbevf_swap_tx_ring(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *ring,
+				 struct ixgbevf_ring *new)
+{
+	unsigned long timeout;
+
+	if (!ring_is_xdp(ring) && !test_bit(__IXGBEVF_DOWN, &adapter->state)) {
+		/* NAPI keeps cleaning, but can no longer wake the queue */
+		ixgbevf_tx_queue_stop(ring);
+
+		timeout = jiffies +
+			  msecs_to_jiffies(IXGBEVF_TX_DRAIN_TIMEOUT_MS);
+		while (READ_ONCE(ring->next_to_clean) !=
+		       READ_ONCE(ring->next_to_use) &&
+		       time_before(jiffies, timeout))
+			usleep_range(100, 200);
+	}
+
+	ixgbevf_tx_ring_stop(adapter, ring);
+	ixgbevf_free_tx_resources(ring);
+	ixgbevf_take_ring_resources(ring, new);
+	ixgbevf_tx_ring_start(adapter, ring);
+}
+
+/**
+ * ixgbevf_swap_rx_ring - move a live Rx ring onto new resources
+ * @adapter: board private structure
+ * @ring: ring in use by the hardware
+ * @new: clone of @ring holding the new descriptors, consumed on return
+ **/
+static void ixgbevf_swap_rx_ring(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *ring,
+				 struct ixgbevf_ring *new)
+{
+	ixgbevf_rx_ring_stop(adapter, ring);
+	ixgbevf_free_rx_resources(ring);
+	ixgbevf_take_ring_resources(ring, new);
+	ixgbevf_rx_ring_start(adapter, ring);
+}
+
+/**
+ * ixgbevf_migrate_ring - move a live ring's memory to its vector's node
+ * @adapter: board private structure
+ * @ring: Tx, XDP or Rx ring in use
+ * @rx: true if @ring is an Rx ring
+ *
+ * New descriptors and buffer_info are set up on the vector's node first,
+ * then only @ring (and whatever shares its vector) is paused for the swap.
+ * On failure the ring is left untouched on its old node.
+ *
+ * Return: 0 on success, -ENOMEM if the new memory could not be allocated.
+ **/
+static int ixgbevf_migrate_ring(struct ixgbevf_adapter *adapter,
+				struct ixgbevf_ring *ring, bool rx)
+{
+	struct ixgbevf_ring *new;
+	int err;
+
+	new = kmalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	*new = *ring;
+	if (rx) {
+#ifdef HAVE_XDP_BUFF_RXQ
+		memset(&new->xdp_rxq, 0, sizeof(new->xdp_rxq));
+#endif /* HAVE_XDP_BUFF_RXQ */
+		err = ixgbevf_setup_rx_resources(adapter, new);
+		if (!err)
+			ixgbevf_swap_rx_ring(adapter, ring, new);
+	} else {
+		err = ixgbevf_setup_tx_resources(new);
+		if (!err)
+			ixgbevf_swap_tx_ring(adapter, ring, new);
+	}
+
+	kfree(new);
+	return err;
+}
+
+/**
+ * ixgbevf_resize_rings - change the descriptor count of every ring
+ * @adapter: board private structure
+ * @new_tx_count: new Tx and XDP ring size, already aligned and bounded
+ * @new_rx_count: new Rx ring size, already aligned and bounded
+ *
+ * New resources are allocated for every affected ring up front, then each
+ * ring is quiesced, swapped and restarted on its own while the remaining
+ * queues keep running. Must be called with the RTNL held.
+ *
+ * Return: 0 on success, -ENOMEM if allocation fails, in which case the
+ * rings are left untouched.
+ **/
+int ixgbevf_resize_rings(struct ixgbevf_adapter *adapter, u32 new_tx_count,
+			 u32 new_rx_count)
+{
+	struct ixgbevf_ring *tx_ring = NULL, *rx_ring = NULL;
+	int i, j, err = 0;
+
+	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
+		msleep(1);
+
+	if (!netif_running(adapter->netdev)) {
+		for (i = 0; i < adapter->num_tx_queues; i++)
+			adapter->tx_ring[i]->count = new_tx_count;
+		for (i = 0; i < adapter->num_xdp_queues; i++)
+			adapter->xdp_ring[i]->count = new_tx_count;
+		for (i = 0; i < adapter->num_rx_queues; i++)
+			adapter->rx_ring[i]->count = new_rx_count;
+		adapter->tx_ring_count = new_tx_count;
+		adapter->xdp_ring_count = new_tx_count;
+		adapter->rx_ring_count = new_rx_count;
+		goto clear_reset;
+	}
+
+	if (new_tx_count != adapter->tx_ring_count) {
+		tx_ring = vmalloc((adapter->num_tx_queues +
+				   adapter->num_xdp_queues) * sizeof(*tx_ring));
+		if (!tx_ring) {
+			err = -ENOMEM;
+			goto clear_reset;
+		}
+
+		for (i = 0; i < adapter->num_tx_queues; i++) {
+			/* clone ring and setup updated count */
+			tx_ring[i] = *adapter->tx_ring[i];
+			tx_ring[i].count = new_tx_count;
+			err = ixgbevf_setup_tx_resources(&tx_ring[i]);
+			if (err) {
+				while (i) {
+					i--;
+					ixgbevf_free_tx_resources(&tx_ring[i]);
+				}
+
+				vfree(tx_ring);
+				tx_ring = NULL;
+
+				goto clear_reset;
+			}
+		}
+
+		for (j = 0; j < adapter->num_xdp_queues; i++, j++) {
+			/* clone ring and setup updated count */
+			tx_ring[i] = *adapter->xdp_ring[j];
+			tx_ring[i].count = new_tx_count;
+			err = ixgbevf_setup_tx_resources(&tx_ring[i]);
+			if (err) {
+				while (i) {
+					i--;
+					ixgbevf_free_tx_resources(&tx_ring[i]);
+				}
+
+				vfree(tx_ring);
+				tx_ring = NULL;
+
+				goto clear_reset;
+			}
+		}
+	}
+
+	if (new_rx_count != adapter->rx_ring_count) {
+		rx_ring = vmalloc(adapter->num_rx_queues * sizeof(*rx_ring));
+		if (!rx_ring) {
+			err = -ENOMEM;
+			goto clear_reset;
+		}
+
+		for (i = 0; i < adapter->num_rx_queues; i++) {
+			/* clone ring and setup updated count */
+			rx_ring[i] = *adapter->rx_ring[i];
+#ifdef HAVE_XDP_BUFF_RXQ
+
+			/* Clear copied XDP RX-queue info */
+			memset(&rx_ring[i].xdp_rxq, 0,
+			       sizeof(rx_ring[i].xdp_rxq));
+#endif /* HAVE_XDP_BUFF_RXQ */
+
+			rx_ring[i].count = new_rx_count;
+			err = ixgbevf_setup_rx_resources(adapter, &rx_ring[i]);
+			if (err) {
+				while (i) {
+					i--;
+					ixgbevf_free_rx_resources(&rx_ring[i]);
+				}
+
+				vfree(rx_ring);
+				rx_ring = NULL;
+
+				goto clear_reset;
+			}
+		}
+	}
+
+	/* swap one ring at a time, the others keep running meanwhile */
+
+	/* Tx */
+	if (tx_ring) {
+		for (i = 0; i < adapter->num_tx_queues; i++)
+			ixgbevf_swap_tx_ring(adapter, adapter->tx_ring[i],
+					     &tx_ring[i]);
+		adapter->tx_ring_count = new_tx_count;
+
+		for (j = 0; j < adapter->num_xdp_queues; i++, j++)
+			ixgbevf_swap_tx_ring(adapter, adapter->xdp_ring[j],
+					     &tx_ring[i]);
+		adapter->xdp_ring_count = new_tx_count;
+
+		vfree(tx_ring);
+		tx_ring = NULL;
+	}
+
+	/* Rx */
+	if (rx_ring) {
+		for (i = 0; i < adapter->num_rx_queues; i++)
+			ixgbevf_swap_rx_ring(adapter, adapter->rx_ring[i],
+					     &rx_ring[i]);
+		adapter->rx_ring_count = new_rx_count;
+
+		vfree(rx_ring);
+		rx_ring = NULL;
+	}
+
+	ixgbevf_autotune_reset(adapter);
+
+clear_reset:
+	/* free Tx resources if Rx error is encountered */
+	if (tx_ring) {
+		for (i = 0;
+		     i < adapter->num_tx_queues + adapter->num_xdp_queues; i++)
+			ixgbevf_free_tx_resources(&tx_ring[i]);
+		vfree(tx_ring);
+	}
+
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+	return err;
+}
+
+/**
+ * ixgbevf_reconfigure_rx_rings - apply a new MTU or Rx buffer mode in place
+ * @adapter: board private structure
+ *
+ * Rather than a full down/up, which resets the VF, renegotiates with the PF
+ * and tears down the interrupts, each Rx ring is quiesced on its own, its
+ * buffer mode recomputed and its RLPML and SRRCTL reprogrammed. Mapped pages
+ * are kept when the buffer layout does not change. The PF must already have
+ * accepted the new maximum frame size. Must be called with the RTNL held.
+ **/
+void ixgbevf_reconfigure_rx_rings(struct ixgbevf_adapter *adapter)
+{
+	int i;
+
+	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
+		msleep(1);
+
+	if (!netif_running(adapter->netdev) ||
+	    test_bit(__IXGBEVF_DOWN, &adapter->state))
+		goto clear_reset;
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct ixgbevf_ring *ring = adapter->rx_ring[i];
+
+		ixgbevf_rx_ring_stop(adapter, ring);
+		ixgbevf_park_rx_ring(adapter, ring);
+#ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
+		ixgbevf_set_rx_buffer_len(adapter, ring);
+#endif
+		ixgbevf_rx_ring_start(adapter, ring);
+	}
+
+clear_reset:
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+}
+
+#ifdef HAVE_TX_MQ
+/**
+ * ixgbevf_add_q_vectors - bring up queue pairs past the current ones
+ * @adapter: board private structure
+ * @count: new number of queue pairs, larger than the current one
+ *
+ * Each new pair gets a q_vector of its own on the MSI-X entry of the same
+ * index. Everything is allocated before the stack or RSS can see the new
+ * queues, so a failure leaves the running pairs as they were.
+ *
+ * Return: 0 on success, negative on failure.
+ **/
+static int ixgbevf_add_q_vectors(struct ixgbevf_adapter *adapter, int count)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct ixgbe_hw *hw = &adapter->hw;
+	unsigned int ri = adapter->num_rx_queues;
+	unsigned int ti = adapter->num_tx_queues;
+	int old = adapter->num_q_vectors;
+	int v_idx, err;
+
+	for (v_idx = old; v_idx < count; v_idx++) {
+		err = ixgbevf_alloc_q_vector(adapter, v_idx, 1, v_idx, 0, 0,
+					     1, v_idx);
+		if (err)
+			goto err_unwind;
+
+		err = ixgbevf_setup_tx_resources(adapter->tx_ring[v_idx]);
+		if (err)
+			goto err_free_q_vector;
+
+		err = ixgbevf_setup_rx_resources(adapter,
+						 adapter->rx_ring[v_idx]);
+		if (err)
+			goto err_free_tx;
+
+		err = ixgbevf_request_q_vector_irq(adapter, v_idx, &ri, &ti);
+		if (err)
+			goto err_free_rx;
+	}
+
+	err = netif_set_real_num_tx_queues(netdev, count);
+	if (err)
+		goto err_unwind;
+
+	err = netif_set_real_num_rx_queues(netdev, count);
+	if (err) {
+		netif_set_real_num_tx_queues(netdev, old);
+		goto err_unwind;
+	}
+
+	for (v_idx = old; v_idx < count; v_idx++) {
+		ixgbevf_configure_tx_ring(adapter, adapter->tx_ring[v_idx]);
+#ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
+		ixgbevf_set_rx_buffer_len(adapter, adapter->rx_ring[v_idx]);
+#endif
+		ixgbevf_configure_rx_ring(adapter, adapter->rx_ring[v_idx]);
+	}
+
+	adapter->num_tx_queues = count;
+	adapter->num_rx_queues = count;
+	adapter->num_q_vectors = count;
+
+	ixgbevf_configure_msix(adapter);
+	ixgbevf_irq_enable(adapter);
+
+	/* the new rings are live, let RSS spread traffic over them */
+	ixgbevf_setup_psrtype(adapter);
+	if (hw->mac.type >= ixgbe_mac_X550_vf)
+		ixgbevf_setup_vfmrqc(adapter);
+
+	for (v_idx = old; v_idx < count; v_idx++) {
+		ixgbevf_restart_q_vector(adapter->q_vector[v_idx]);
+		netif_tx_wake_queue(txring_txq(adapter->tx_ring[v_idx]));
+	}
+
+	return 0;
+
+err_free_rx:
+	ixgbevf_free_rx_resources(adapter->rx_ring[v_idx]);
+err_free_tx:
+	ixgbevf_free_tx_resources(adapter->tx_ring[v_idx]);
+err_free_q_vector:
+	ixgbevf_free_q_vector(adapter, v_idx);
+err_unwind:
+	while (v_idx-- > old) {
+		ixgbevf_free_q_vector_irq(adapter, v_idx);
+		ixgbevf_free_tx_resources(adapter->tx_ring[v_idx]);
+		ixgbevf_free_rx_resources(adapter->rx_ring[v_idx]);
+		ixgbevf_free_q_vector(adapter, v_idx);
+	}
+
+	return err;
+}
+
+/**
+ * ixgbevf_remove_q_vectors - tear down the queue pairs past @count
+ * @adapter: board private structure
+ * @count: new number of queue pairs, smaller than the current one
+ *
+ * The stack and RSS are steered away from the pairs going away before
+ * their rings are stopped, so the remaining pairs never stop.
+ **/
+static void ixgbevf_remove_q_vectors(struct ixgbevf_adapter *adapter,
+				     int count)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct ixgbe_hw *hw = &adapter->hw;
+	int v_idx;
+
+	netif_set_real_num_tx_queues(netdev, count);
+	netif_set_real_num_rx_queues(netdev, count);
+
+	adapter->num_tx_queues = count;
+	adapter->num_rx_queues = count;
+
+	ixgbevf_setup_psrtype(adapter);
+	if (hw->mac.type >= ixgbe_mac_X550_vf)
+		ixgbevf_setup_vfmrqc(adapter);
+
+	for (v_idx = adapter->num_q_vectors - 1; v_idx >= count; v_idx--) {
+		struct ixgbevf_ring *tx_ring = adapter->tx_ring[v_idx];
+		struct ixgbevf_ring *rx_ring = adapter->rx_ring[v_idx];
+
+		/* also pauses the vector, which serves only this pair */
+		ixgbevf_tx_ring_stop(adapter, tx_ring);
+		ixgbevf_disable_rx_queue(adapter, rx_ring);
+
+		IXGBE_WRITE_REG(hw, IXGBE_VTEIMC, BIT(v_idx));
+		ixgbevf_free_q_vector_irq(adapter, v_idx);
+
+		ixgbevf_free_tx_resources(tx_ring);
+		ixgbevf_free_rx_resources(rx_ring);
+		ixgbevf_free_q_vector(adapter, v_idx);
+	}
+
+	adapter->num_q_vectors = count;
+
+	ixgbevf_configure_msix(adapter);
+	ixgbevf_irq_enable(adapter);
+}
+#endif /* HAVE_TX_MQ */
+
+/**
+ * ixgbevf_change_q_vectors - grow or shrink the queue pairs in place
+ * @adapter: board private structure
+ * @count: new number of queue pairs
+ *
+ * Only works while every q_vector serves exactly one Tx/Rx pair, before
+ * and after the change, and the MSI-X vectors already enabled are enough.
+ * Only the q_vectors and rings past the smaller of the two counts are
+ * torn down or brought up, the others keep running. The mailbox vector
+ * sits on the last MSI-X entry and is not touched either.
+ *
+ * Return: 0 on success, -EOPNOTSUPP if the interface has to be rebuilt
+ * instead, or another negative value if bringing up new pairs failed.
+ **/
+static int ixgbevf_change_q_vectors(struct ixgbevf_adapter *adapter,
+				    u16 count)
+{
+#ifdef HAVE_TX_MQ
+	int old = adapter->num_q_vectors;
+	int err = 0;
+
+	if (!netif_running(adapter->netdev) || !adapter->msix_entries ||
+	    adapter->xdp_prog || adapter->num_tcs > 1 ||
+	    (adapter->flags & (IXGBEVF_FLAG_IRQ_FREE_POLL |
+			       IXGBEVF_FLAG_RX_FANOUT)))
+		return -EOPNOTSUPP;
+
+	if (adapter->num_rx_queues != old || adapter->num_tx_queues != old ||
+	    count > num_online_cpus() || count > adapter->other_vector)
+		return -EOPNOTSUPP;
+
+	while (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state))
+		msleep(1);
+
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		err = -EOPNOTSUPP;
+	else if (count > old)
+		err = ixgbevf_add_q_vectors(adapter, count);
+	else if (count < old)
+		ixgbevf_remove_q_vectors(adapter, count);
+
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+
+	return err;
+#else
+	return -EOPNOTSUPP;
+#endif /* HAVE_TX_MQ */
+}
+
+/**
+ * ixgbevf_rebuild_q_vectors - rebuild the interrupt scheme for a queue count
+ * @adapter: board private structure, the interface must be closed
+ * @count: requested number of combined queues, 0 for the default
+ *
+ * The MSI-X vectors are kept if the mailbox entry is past every queue
+ * vector the new layout needs, so growing or shrinking within the vectors
+ * we already have does not go through pci_disable_msix().
+ *
+ * Return: 0 on success, negative on failure.
+ **/
+static int ixgbevf_rebuild_q_vectors(struct ixgbevf_adapter *adapter,
+				     u16 count)
+{
+	int err;
+
+	adapter->num_req_queues = count;
+
+	ixgbevf_free_q_vectors(adapter);
+	ixgbevf_set_num_queues(adapter);
+
+	if (adapter->msix_entries &&
+	    ixgbevf_q_vector_budget(adapter) <= adapter->other_vector) {
+		adapter->num_q_vectors = ixgbevf_q_vector_budget(adapter);
+	} else {
+		ixgbevf_reset_interrupt_capability(adapter);
+		err = ixgbevf_set_interrupt_capability(adapter);
+		if (err) {
+			dev_err(&adapter->pdev->dev,
+				"Unable to setup interrupt capabilities\n");
+			return err;
+		}
+	}
+
+	err = ixgbevf_alloc_q_vectors(adapter);
+	if (err) {
+		dev_err(&adapter->pdev->dev,
+			"Unable to allocate memory for queue vectors\n");
+		ixgbevf_reset_interrupt_capability(adapter);
+		return err;
+	}
+
+	return 0;
+}
+
+/**
+ * ixgbevf_set_queue_count - change the number of queue pairs at runtime
+ * @adapter: board private structure
+ * @count: requested number of combined queues, 0 for the default
+ *
+ * Adds or removes queue pairs in place when ixgbevf_change_q_vectors()
+ * can, and closes the interface to rebuild the q_vectors and rings
+ * otherwise. If the new count cannot be set up, the previous one is
+ * restored. Must be called with the RTNL lock held.
+ *
+ * Return: 0 on success, negative on failure.
+ **/
+int ixgbevf_set_queue_count(struct ixgbevf_adapter *adapter, u16 count)
+{
+	struct net_device *netdev = adapter->netdev;
+	u16 old_count = adapter->num_req_queues;
+	int err;
+
+	err = ixgbevf_change_q_vectors(adapter, count);
+	if (!err) {
+		adapter->num_req_queues = count;
+		ixgbevf_autotune_reset(adapter);
+		return 0;
+	}
+
+	if (netif_running(netdev))
+		ixgbevf_close(netdev);
+
+	err = ixgbevf_rebuild_q_vectors(adapter, count);
+	if (err && ixgbevf_rebuild_q_vectors(adapter, old_count)) {
+		dev_err(&adapter->pdev->dev,
+			"Unable to restore the previous queue count\n");
+		if (netif_running(netdev))
+			dev_close(netdev);
+		return err;
+	}
+
+	if (netif_running(netdev)) {
+		int ret = ixgbevf_open(netdev);
+
+		/* leave the interface closed rather than half open */
+		if (ret) {
+			dev_close(netdev);
+			err = err ? : ret;
+		}
+	}
+
+	return err;
+}
+
+/**
+ * ixgbevf_autotune_count - pick the next size for one class of rings
+ * @count: current ring size
+ * @pressure: new full-ring events since the last pass
+ * @packets: packets moved since the last pass
+ * @idle: consecutive quiet passes, updated
+ * @max: upper bound set through ethtool
+ *
+ * Return: the ring size to use from now on.
+ **/
+static u32 ixgbevf_autotune_count(u32 count, u64 pressure, u64 packets,
+				  u8 *idle, u32 max)
+{
+	if (pressure) {
+		*idle = 0;
+		return min_t(u32, count * 2, max);
+	}
+
+	/* the ring did not even turn over once during the interval */
+	if (packets < count && count > IXGBEVF_AUTOTUNE_MIN_DESC) {
+		if (++*idle < IXGBEVF_AUTOTUNE_IDLE_PERIODS)
+			return count;
+
+		*idle = 0;
+		return max_t(u32, ALIGN(count / 2, IXGBE_REQ_TX_DESCRIPTOR_MULTIPLE),
+			     IXGBEVF_AUTOTUNE_MIN_DESC);
+	}
+
+	*idle = 0;
+	return count;
+}
+
+/**
+ * ixgbevf_autotune_sample - sum the counters the ring auto-tuner works on
+ * @adapter: board private structure
+ * @tx_pressure: returns the Tx full-ring events of all Tx rings
+ * @rx_pressure: returns the Rx backlog events of all Rx rings
+ * @tx_packets: returns the packets sent on all Tx rings
+ * @rx_packets: returns the packets received on all Rx rings
+ **/
+static void ixgbevf_autotune_sample(struct ixgbevf_adapter *adapter,
+				    u64 *tx_pressure, u64 *rx_pressure,
+				    u64 *tx_packets, u64 *rx_packets)
+{
+	int i;
+
+	*tx_pressure = 0;
+	*rx_pressure = 0;
+	*tx_packets = 0;
+	*rx_packets = 0;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		struct ixgbevf_ring *tx_ring = adapter->tx_ring[i];
+
+		*tx_pressure += tx_ring->tx_stats.tx_busy +
+				tx_ring->tx_stats.restart_queue;
+		*tx_packets += tx_ring->stats.packets;
+	}
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct ixgbevf_ring *rx_ring = adapter->rx_ring[i];
+
+		*rx_pressure += rx_ring->rx_stats.backlog_high;
+		*rx_packets += rx_ring->stats.packets;
+	}
+}
+
+/**
+ * ixgbevf_autotune_reset - restart the ring auto-tuner from the live counters
+ * @adapter: board private structure
+ *
+ * Must be called whenever the auto-tuner is enabled and whenever rings are
+ * reallocated, since the per-ring counters then start over and the next
+ * pass would otherwise compare them against baselines of rings that are
+ * gone.
+ **/
+void ixgbevf_autotune_reset(struct ixgbevf_adapter *adapter)
+{
+	ixgbevf_autotune_sample(adapter, &adapter->autotune_tx_pressure,
+				&adapter->autotune_rx_pressure,
+				&adapter->autotune_tx_packets,
+				&adapter->autotune_rx_packets);
+	adapter->autotune_tx_idle = 0;
+	adapter->autotune_rx_idle = 0;
+	adapter->autotune_next = jiffies + IXGBEVF_AUTOTUNE_INTERVAL;
+}
+
+/* counters of removed rings drop out of the sums, never report those as
+ * a huge delta
+ */
+static u64 ixgbevf_autotune_delta(u64 now, u64 base)
+{
+	return now > base ? now - base : 0;
+}
+
+/**
+ * ixgbevf_ring_autotune_subtask - grow busy rings and shrink idle ones
+ * @adapter: board private structure
+ *
+ * Tx pressure is a ring found full at transmit time, Rx pressure a poll
+ * that found the ring over half full. Allocation failures are left out,
+ * a larger ring would only need more memory.
+ **/
+static void ixgbevf_ring_autotune_subtask(struct ixgbevf_adapter *adapter)
+{
+	u64 tx_pressure, rx_pressure, tx_packets, rx_packets;
+	u32 tx_count, rx_count;
+
+	if (!(adapter->flags & IXGBEVF_FLAG_RING_AUTOTUNE) ||
+	    test_bit(__IXGBEVF_DOWN, &adapter->state) ||
+	    test_bit(__IXGBEVF_RESETTING, &adapter->state) ||
+	    time_before(jiffies, adapter->autotune_next))
+		return;
+
+	adapter->autotune_next = jiffies + IXGBEVF_AUTOTUNE_INTERVAL;
+
+	ixgbevf_autotune_sample(adapter, &tx_pressure, &rx_pressure,
+				&tx_packets, &rx_packets);
+
+	tx_count = ixgbevf_autotune_count(adapter->tx_ring_count,
+					  ixgbevf_autotune_delta(tx_pressure,
+						adapter->autotune_tx_pressure),
+					  ixgbevf_autotune_delta(tx_packets,
+						adapter->autotune_tx_packets),
+					  &adapter->autotune_tx_idle,
+					  adapter->tx_ring_max);
+	rx_count = ixgbevf_autotune_count(adapter->rx_ring_count,
+					  ixgbevf_autotune_delta(rx_pressure,
+						adapter->autotune_rx_pressure),
+					  ixgbevf_autotune_delta(rx_packets,
+						adapter->autotune_rx_packets),
+					  &adapter->autotune_rx_idle,
+					  adapter->rx_ring_max);
+
+	adapter->autotune_tx_pressure = tx_pressure;
+	adapter->autotune_rx_pressure = rx_pressure;
+	adapter->autotune_tx_packets = tx_packets;
+	adapter->autotune_rx_packets = rx_packets;
+
+	if (tx_count == adapter->tx_ring_count &&
+	    rx_count == adapter->rx_ring_count)
+		return;
+
+	rtnl_lock();
+	if (!test_bit(__IXGBEVF_DOWN, &adapter->state) &&
+	    !ixgbevf_resize_rings(adapter, tx_count, rx_count)) {
+		adapter->ring_autotune_resizes++;
+		e_info(drv, "Ring sizes auto-tuned to Tx %u / Rx %u\n",
+		       tx_count, rx_count);
+	}
+	rtnl_unlock();
+}
+
+/**
+ * ixgbevf_trim_rx_ring - release the pages of an idle Rx ring
+ * @adapter: board private structure
+ * @ring: ring to trim
+ *
+ * Posted buffers cannot be taken back from a running queue, so the ring is
+ * stopped, emptied and restarted with IXGBEVF_RX_RECLAIM_LOW_WATER buffers.
+ **/
+static void ixgbevf_trim_rx_ring(struct ixgbevf_adapter *adapter,
+				 struct ixgbevf_ring *ring)
+{
+	ixgbevf_rx_ring_stop(adapter, ring);
+	ixgbevf_clean_rx_ring(ring);
+
+	set_bit(__IXGBEVF_RX_TRIMMED, &ring->state);
+	ring->fill_limit = IXGBEVF_RX_RECLAIM_LOW_WATER;
+
+	ixgbevf_rx_ring_start(adapter, ring);
+	adapter->rx_reclaim_trims++;
+}
+
+/**
+ * ixgbevf_rx_reclaim_subtask - trim Rx rings that have been idle for long
+ * @adapter: board private structure
+ *
+ * Rings are given back their buffers by ixgbevf_rx_regrow() once they
+ * receive again, also after the reclaim has been switched off.
+ **/
+static void ixgbevf_rx_reclaim_subtask(struct ixgbevf_adapter *adapter)
+{
+	bool trim = false;
+	int i;
+
+	if (!(adapter->flags & IXGBEVF_FLAG_RX_RECLAIM) ||
+	    test_bit(__IXGBEVF_DOWN, &adapter->state) ||
+	    test_bit(__IXGBEVF_RESETTING, &adapter->state))
+		return;
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct ixgbevf_ring *ring = adapter->rx_ring[i];
+		u64 packets = ring->stats.packets;
+
+		if (packets != ring->reclaim_packets ||
+		    ring->fill_limit <= IXGBEVF_RX_RECLAIM_LOW_WATER) {
+			ring->reclaim_packets = packets;
+			ring->reclaim_idle = 0;
+			continue;
+		}
+
+		if (ring->reclaim_idle < IXGBEVF_RX_RECLAIM_IDLE_PERIODS)
+			ring->reclaim_idle++;
+		if (ring->reclaim_idle == IXGBEVF_RX_RECLAIM_IDLE_PERIODS)
+			trim = true;
+	}
+
+	if (!trim)
+		return;
+
+	rtnl_lock();
+
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state) ||
+	    test_bit(__IXGBEVF_REMOVING, &adapter->state) ||
+	    test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state)) {
+		rtnl_unlock();
+		return;
+	}
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct ixgbevf_ring *ring = adapter->rx_ring[i];
+
+		if (ring->reclaim_idle < IXGBEVF_RX_RECLAIM_IDLE_PERIODS)
+			continue;
+
+		ixgbevf_trim_rx_ring(adapter, ring);
+		ring->reclaim_idle = 0;
+	}
+
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+	rtnl_unlock();
+}
+
+/**
+ * ixgbevf_restart_tx_ring - recover a hung Tx ring without a full reset
+ * @adapter: board private structure
+ * @ring: ring to restart
  *
- * Return 0 on success, negative on failure
+ * Whatever was still posted on the ring is dropped.
  **/
-int ixgbevf_setup_tx_resources(struct ixgbevf_ring *tx_ring)
+static void ixgbevf_restart_tx_ring(struct ixgbevf_adapter *adapter,
+				    struct ixgbevf_ring *ring)
 {
-	int size;
-
-	size = sizeof(struct ixgbevf_tx_buffer) * tx_ring->count;
-	tx_ring->tx_buffer_info = vmalloc(size);
-	if (!tx_ring->tx_buffer_info)
-		goto err;
-
-	u64_stats_init(&tx_ring->syncp);
-
-	/* round up to nearest 4K */
-	tx_ring->size = tx_ring->count * sizeof(union ixgbe_adv_tx_desc);
-	tx_ring->size = ALIGN(tx_ring->size, 4096);
-
-	tx_ring->desc = dma_alloc_coherent(tx_ring->dev, tx_ring->size,
-					   &tx_ring->dma, GFP_KERNEL);
-	if (!tx_ring->desc)
-		goto err;
+	ixgbevf_tx_ring_stop(adapter, ring);
+	ixgbevf_clean_tx_ring(ring);
+	ixgbevf_tx_ring_start(adapter, ring);
 
-	return 0;
-
-err:
-	vfree(tx_ring->tx_buffer_info);
-	tx_ring->tx_buffer_info = NULL;
-	dev_err(tx_ring->dev, "Unable to allocate memory for the Tx descriptor ring\n");
-	return -ENOMEM;
+	adapter->tx_timeout_count++;
+	netdev_warn(adapter->netdev, "%s queue %u restarted after a hang\n",
+		    ring_is_xdp(ring) ? "XDP" : "Tx", ring->queue_index);
 }
 
 /**
- * ixgbevf_setup_all_tx_resources - allocate all queues Tx resources
+ * ixgbevf_ring_restart_subtask - restart the Tx rings flagged as hung
  * @adapter: board private structure
  *
- * If this function returns with an error, then it's possible one or
- * more of the rings is populated (while the rest are not).  It is the
- * callers duty to clean those orphaned rings.
- *
- * Return 0 on success, negative on failure
+ * A full reset, should one be pending, clears the per-ring requests in
+ * ixgbevf_configure_tx_ring() instead.
  **/
-static int ixgbevf_setup_all_tx_resources(struct ixgbevf_adapter *adapter)
+static void ixgbevf_ring_restart_subtask(struct ixgbevf_adapter *adapter)
 {
-	int i, j = 0, err = 0;
+	struct ixgbevf_ring *ring;
+	int i;
 
-	for (i = 0; i < adapter->num_tx_queues; i++) {
-		err = ixgbevf_setup_tx_resources(adapter->tx_ring[i]);
-		if (!err)
-			continue;
-		DPRINTK(PROBE, ERR, "Allocation for Tx Queue %u failed\n", i);
-		goto err_setup_tx;
+	if (!test_and_clear_bit(__IXGBEVF_RING_RESTART_REQUESTED,
+				&adapter->state))
+		return;
+
+	rtnl_lock();
+
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state) ||
+	    test_bit(__IXGBEVF_REMOVING, &adapter->state)) {
+		rtnl_unlock();
+		return;
 	}
 
-	for (j = 0; j < adapter->num_xdp_queues; j++) {
-		err = ixgbevf_setup_tx_resources(adapter->xdp_ring[j]);
-		if (!err)
-			continue;
-		hw_dbg(&adapter->hw, "Allocation for XDP Queue %u failed\n", j);
-		goto err_setup_tx;
+	/* a reset or ring resize is running, try again on the next pass */
+	if (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state)) {
+		set_bit(__IXGBEVF_RING_RESTART_REQUESTED, &adapter->state);
+		rtnl_unlock();
+		return;
 	}
 
-	return 0;
-err_setup_tx:
-	/* rewind the index freeing the rings as we go */
-	while (j--)
-		ixgbevf_free_tx_resources(adapter->xdp_ring[j]);
-	while (i--)
-		ixgbevf_free_tx_resources(adapter->tx_ring[i]);
+	for (i = 0; i < adapter->num_tx_queues + adapter->num_xdp_queues; i++) {
+		ring = i < adapter->num_tx_queues ? adapter->tx_ring[i] :
+			adapter->xdp_ring[i - adapter->num_tx_queues];
 
-	return err;
+		if (test_and_clear_bit(__IXGBEVF_TX_RESTART_REQUESTED,
+				       &ring->state))
+			ixgbevf_restart_tx_ring(adapter, ring);
+	}
+
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+	rtnl_unlock();
 }
 
+#if defined(HAVE_NETDEV_QUEUE_MGMT_OPS) && !defined(HAVE_NETDEV_OPS_LOCK)
+/* Legacy only: on kernels with netdev instance locking, queue_mgmt_ops
+ * make the core call every ndo with the netdev lock held, which the NAPI
+ * handling here (napi_disable() rather than the _locked variants) does
+ * not support. The per-ring restart used by Tx hang recovery works on
+ * every kernel.
+ */
+
 /**
- * ixgbevf_setup_rx_resources - allocate Rx resources (Descriptors)
- * @adapter: board private structure
- * @rx_ring: Rx descriptor ring (for a specific queue) to setup
+ * ixgbevf_queue_mem_alloc - allocate resources for an Rx queue restart
+ * @dev: network interface device structure
+ * @per_queue_mem: ixgbevf_ring sized buffer owned by the core
+ * @idx: Rx queue index
  *
- * Returns 0 on success, negative on failure
+ * Return: 0 on success, -ENOMEM on failure.
  **/
-int ixgbevf_setup_rx_resources(struct ixgbevf_adapter *adapter,
-			       struct ixgbevf_ring *rx_ring)
+static int ixgbevf_queue_mem_alloc(struct net_device *dev,
+				   void *per_queue_mem, int idx)
 {
-	int size;
-
-	size = sizeof(struct ixgbevf_rx_buffer) * rx_ring->count;
-	rx_ring->rx_buffer_info = vmalloc(size);
-	if (!rx_ring->rx_buffer_info)
-		goto err;
-
-	u64_stats_init(&rx_ring->syncp);
-
-	/* Round up to nearest 4K */
-	rx_ring->size = rx_ring->count * sizeof(union ixgbe_adv_rx_desc);
-	rx_ring->size = ALIGN(rx_ring->size, 4096);
-
-	rx_ring->desc = dma_alloc_coherent(rx_ring->dev, rx_ring->size,
-					   &rx_ring->dma, GFP_KERNEL);
-
-	if (!rx_ring->desc)
-		goto err;
+	struct ixgbevf_adapter *adapter = netdev_priv(dev);
+	struct ixgbevf_ring *ring = per_queue_mem;
 
+	*ring = *adapter->rx_ring[idx];
 #ifdef HAVE_XDP_BUFF_RXQ
-	/* XDP RX-queue info */
-	if (xdp_rxq_info_reg(&rx_ring->xdp_rxq, adapter->netdev,
-			     rx_ring->queue_index, 0) < 0)
-		goto err;
-
+	memset(&ring->xdp_rxq, 0, sizeof(ring->xdp_rxq));
 #endif /* HAVE_XDP_BUFF_RXQ */
-	rx_ring->xdp_prog = adapter->xdp_prog;
 
-	return 0;
-err:
-	vfree(rx_ring->rx_buffer_info);
-	rx_ring->rx_buffer_info = NULL;
-	dev_err(rx_ring->dev, "Unable to allocate memory for the Rx descriptor ring\n");
-	return -ENOMEM;
+	return ixgbevf_setup_rx_resources(adapter, ring);
 }
 
 /**
- * ixgbevf_setup_all_rx_resources - allocate all queues Rx resources
- * @adapter: board private structure
- *
- * If this function returns with an error, then it's possible one or
- * more of the rings is populated (while the rest are not).  It is the
- * callers duty to clean those orphaned rings.
+ * ixgbevf_queue_mem_free - release resources handed out by queue_stop
+ * @dev: network interface device structure
+ * @per_queue_mem: ring clone to free
+ **/
+static void ixgbevf_queue_mem_free(struct net_device __always_unused *dev,
+				   void *per_queue_mem)
+{
+	struct ixgbevf_ring *ring = per_queue_mem;
+
+	if (ring->desc)
+		ixgbevf_free_rx_resources(ring);
+}
+
+/**
+ * ixgbevf_queue_start - bring an Rx queue up on new resources
+ * @dev: network interface device structure
+ * @per_queue_mem: ring clone from ixgbevf_queue_mem_alloc, consumed
+ * @idx: Rx queue index
  *
- * Return 0 on success, negative on failure
+ * Return: always 0.
  **/
-static int ixgbevf_setup_all_rx_resources(struct ixgbevf_adapter *adapter)
+static int ixgbevf_queue_start(struct net_device *dev, void *per_queue_mem,
+			       int idx)
 {
-	int i, err = 0;
+	struct ixgbevf_adapter *adapter = netdev_priv(dev);
+	struct ixgbevf_ring *ring = adapter->rx_ring[idx];
 
-	for (i = 0; i < adapter->num_rx_queues; i++) {
-		err = ixgbevf_setup_rx_resources(adapter, adapter->rx_ring[i]);
-		if (!err)
-			continue;
-		DPRINTK(PROBE, ERR, "Allocation for Rx Queue %u failed\n", i);
-		goto err_setup_rx;
-	}
+	ixgbevf_take_ring_resources(ring, per_queue_mem);
+	ixgbevf_rx_ring_start(adapter, ring);
 
 	return 0;
-err_setup_rx:
-	/* rewind the index freeing the rings as we go */
-	while (i--)
-		ixgbevf_free_rx_resources(adapter->rx_ring[i]);
-	return err;
 }
 
 /**
- * ixgbevf_free_rx_resources - Free Rx Resources
- * @rx_ring: ring to clean the resources from
+ * ixgbevf_queue_stop - stop an Rx queue and hand its resources to the core
+ * @dev: network interface device structure
+ * @per_queue_mem: buffer receiving the old ring, freed via queue_mem_free
+ * @idx: Rx queue index
  *
- * Free all receive software resources
+ * Return: always 0.
  **/
-void ixgbevf_free_rx_resources(struct ixgbevf_ring *rx_ring)
+static int ixgbevf_queue_stop(struct net_device *dev, void *per_queue_mem,
+			      int idx)
 {
-	ixgbevf_clean_rx_ring(rx_ring);
+	struct ixgbevf_adapter *adapter = netdev_priv(dev);
+	struct ixgbevf_ring *ring = adapter->rx_ring[idx];
 
-	rx_ring->xdp_prog = NULL;
-#ifdef HAVE_XDP_BUFF_RXQ
-	xdp_rxq_info_unreg(&rx_ring->xdp_rxq);
-#endif /* HAVE_XDP_BUFF_RXQ */
-	vfree(rx_ring->rx_buffer_info);
-	rx_ring->rx_buffer_info = NULL;
+	ixgbevf_rx_ring_stop(adapter, ring);
 
-	dma_free_coherent(rx_ring->dev, rx_ring->size,
-			  rx_ring->desc, rx_ring->dma);
+	*(struct ixgbevf_ring *)per_queue_mem = *ring;
+	ring->desc = NULL;
+	ring->rx_buffer_info = NULL;
+	ring->skb = NULL;
 
-	rx_ring->desc = NULL;
+	return 0;
 }
 
+static const struct netdev_queue_mgmt_ops ixgbevf_queue_mgmt_ops = {
+	.ndo_queue_mem_size	= sizeof(struct ixgbevf_ring),
+	.ndo_queue_mem_alloc	= ixgbevf_queue_mem_alloc,
+	.ndo_queue_mem_free	= ixgbevf_queue_mem_free,
+	.ndo_queue_start	= ixgbevf_queue_start,
+	.ndo_queue_stop		= ixgbevf_queue_stop,
+};
+
+#endif /* HAVE_NETDEV_QUEUE_MGMT_OPS && !HAVE_NETDEV_OPS_LOCK */
 /**
  * ixgbevf_free_all_rx_resources - Free Rx Resources for All Queues
  * @adapter: board private structure
@@ -4623,7 +7098,9 @@ int ixgbevf_close(struct net_device *netdev)
 {
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
 
-	if (netif_device_present(netdev))
+	/* a fast suspend left the rings and IRQs in place for resume */
+	if (netif_device_present(netdev) ||
+	    test_and_clear_bit(__IXGBEVF_SUSPENDED, &adapter->state))
 		ixgbevf_close_suspend(adapter);
 
 	return 0;
@@ -4664,6 +7141,78 @@ static void ixgbevf_queue_reset_subtask(struct ixgbevf_adapter *adapter)
 	rtnl_unlock();
 }
 
+/**
+ * ixgbevf_ring_migrate_subtask - move ring memory after its vector
+ * @adapter: board private structure
+ *
+ * Runs when an affinity notifier reported that a vector moved to another
+ * NUMA node. Every ring whose memory lives on a different node than its
+ * vector is moved there on its own while the others keep running. Passes
+ * are at least IXGBEVF_RING_MIGRATE_INTERVAL apart, so an IRQ bounced
+ * around by irqbalance costs one move per interval at most. Rings that
+ * cannot be moved stay where they are.
+ */
+static void ixgbevf_ring_migrate_subtask(struct ixgbevf_adapter *adapter)
+{
+	struct ixgbevf_ring *ring;
+	int v_idx, moved = 0, stale = 0;
+
+	if (!test_and_clear_bit(__IXGBEVF_RING_MIGRATE_REQUESTED,
+				&adapter->state))
+		return;
+
+	/* if interface is down do nothing, setup will use the new node */
+	if (test_bit(__IXGBEVF_DOWN, &adapter->state))
+		return;
+
+	if (time_before(jiffies, adapter->ring_migrate_next)) {
+		set_bit(__IXGBEVF_RING_MIGRATE_REQUESTED, &adapter->state);
+		return;
+	}
+
+	rtnl_lock();
+
+	if (!netif_running(adapter->netdev) ||
+	    test_bit(__IXGBEVF_DOWN, &adapter->state))
+		goto out;
+
+	/* a reset or ring resize is running, try again on the next pass */
+	if (test_and_set_bit(__IXGBEVF_RESETTING, &adapter->state)) {
+		set_bit(__IXGBEVF_RING_MIGRATE_REQUESTED, &adapter->state);
+		goto out;
+	}
+
+	for (v_idx = 0; v_idx < adapter->num_q_vectors; v_idx++) {
+		struct ixgbevf_q_vector *q_vector = adapter->q_vector[v_idx];
+		int node = READ_ONCE(q_vector->numa_node);
+
+		ixgbevf_for_each_ring(ring, q_vector->tx) {
+			if (ring->numa_node == node)
+				continue;
+			stale++;
+			if (!ixgbevf_migrate_ring(adapter, ring, false))
+				moved++;
+		}
+
+		ixgbevf_for_each_ring(ring, q_vector->rx) {
+			if (ring->numa_node == node)
+				continue;
+			stale++;
+			if (!ixgbevf_migrate_ring(adapter, ring, true))
+				moved++;
+		}
+	}
+
+	clear_bit(__IXGBEVF_RESETTING, &adapter->state);
+	adapter->ring_migrate_next = jiffies + IXGBEVF_RING_MIGRATE_INTERVAL;
+
+	if (stale)
+		e_info(drv, "Moved %d of %d rings to their vector's NUMA node\n",
+		       moved, stale);
+out:
+	rtnl_unlock();
+}
+
 static void ixgbevf_tx_ctxtdesc(struct ixgbevf_ring *tx_ring,
 				u32 vlan_macip_lens, u32 type_tucmd,
 				u32 mss_l4len_idx)
@@ -4986,11 +7535,8 @@ static void ixgbevf_tx_map(struct ixgbevf_ring *tx_ring,
 
 	netdev_tx_sent_queue(txring_txq(tx_ring), first->bytecount);
 
-	/* set the timestamp */
-	first->time_stamp = jiffies;
-
 #ifndef HAVE_TRANS_START_IN_QUEUE
-	tx_ring->netdev->trans_start = first->time_stamp;
+	tx_ring->netdev->trans_start = jiffies;
 #endif
 	/*
 	 * Force memory writes to complete before letting h/w know there
@@ -5097,6 +7643,13 @@ static int ixgbevf_xmit_frame_ring(struct sk_buff *skb,
 	unsigned short f;
 	__be16 protocol = skb->protocol;
 	u8 hdr_len = 0;
+
+	/* a wake-up that raced ixgbevf_tx_queue_stop() must not post here */
+	if (unlikely(test_bit(__IXGBEVF_TX_STOPPED, &tx_ring->state))) {
+		netif_stop_subqueue(tx_ring->netdev, tx_ring->queue_index);
+		return NETDEV_TX_BUSY;
+	}
+
 	/*
 	 * if this is an LLDP ether frame then drop it - VFs do not
 	 * forward LLDP frames.
@@ -5227,11 +7780,11 @@ static int ixgbevf_set_mac(struct net_device *netdev, void *p)
 	if (!is_valid_ether_addr(addr->sa_data))
 		return -EADDRNOTAVAIL;
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	err = hw->mac.ops.set_rar(hw, 0, addr->sa_data, 0, IXGBE_RAH_AV);
 
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 
 	if (err)
 		return -EPERM;
@@ -5269,11 +7822,11 @@ static int ixgbevf_change_mtu(struct net_device *netdev, int new_mtu)
 		return -EPERM;
 	}
 
-	spin_lock_bh(&adapter->mbx_lock);
+	mutex_lock(&adapter->mbx_lock);
 
 	/* notify the PF of our intent to use this size of frame */
 	ret = hw->mac.ops.set_rlpml(hw, max_frame);
-	spin_unlock_bh(&adapter->mbx_lock);
+	mutex_unlock(&adapter->mbx_lock);
 	if (ret)
 		return -EINVAL;
 
@@ -5283,8 +7836,8 @@ static int ixgbevf_change_mtu(struct net_device *netdev, int new_mtu)
 	/* set new MTU */
 	netdev->mtu = new_mtu;
 
-	if (netif_running(netdev))
-		ixgbevf_reinit_locked(adapter);
+	/* only the Rx rings depend on the frame size */
+	ixgbevf_reconfigure_rx_rings(adapter);
 
 	return 0;
 }
@@ -5356,22 +7909,18 @@ static void ixgbevf_netpoll(struct net_device *netdev)
 
 #ifndef USE_REBOOT_NOTIFIER
 /**
- * ixgbevf_suspend - Suspend the network device
+ * __ixgbevf_suspend - quiesce the device and disable it
  * @pdev: Pointer to the PCI device structure
- * @state: Unused power management message indicating the suspend state
+ * @keep: keep the interrupt scheme, IRQs and ring memory for a resume
  *
- * This function suspends the network device, preparing it for a low-power
- * state. It detaches the network device from the system, closes the device
- * if it is running, and clears the interrupt scheme. The function then saves
- * the PCI device state to preserve its configuration. If the device is not
- * already disabled, it disables the PCI device to reduce power consumption.
- *
- * The @state parameter is marked as `__maybe_unused`, indicating that it is
- * not utilized in this function but may be relevant in certain configurations.
+ * With @keep set a running interface is only brought down, with its Rx
+ * pages parked as for a warm restart, and ixgbevf_resume() brings it back
+ * up on the same q_vectors, MSI-X vectors and rings. Otherwise everything
+ * is released, as the device is not coming back.
  *
  * Return: 0 on success, or a negative error code if saving the PCI state fails.
  */
-static int ixgbevf_suspend(struct pci_dev *pdev, pm_message_t __maybe_unused state)
+static int __ixgbevf_suspend(struct pci_dev *pdev, bool keep)
 {
 	struct net_device *netdev = pci_get_drvdata(pdev);
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
@@ -5382,10 +7931,25 @@ static int ixgbevf_suspend(struct pci_dev *pdev, pm_message_t __maybe_unused sta
 	rtnl_lock();
 	netif_device_detach(netdev);
 
-	if (netif_running(netdev))
-		ixgbevf_close_suspend(adapter);
+	/* a detached device gets no new rx_mode calls, flush the last one
+	 * before the mailbox goes away with the device
+	 */
+	cancel_work_sync(&adapter->rx_mode_task);
 
-	ixgbevf_clear_interrupt_scheme(adapter);
+	if (keep) {
+		if (netif_running(netdev)) {
+			set_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
+			ixgbevf_down(adapter);
+			clear_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
+			set_bit(__IXGBEVF_SUSPENDED, &adapter->state);
+		}
+	} else {
+		if (netif_running(netdev) ||
+		    test_and_clear_bit(__IXGBEVF_SUSPENDED, &adapter->state))
+			ixgbevf_close_suspend(adapter);
+
+		ixgbevf_clear_interrupt_scheme(adapter);
+	}
 	rtnl_unlock();
 
 #ifdef CONFIG_PM
@@ -5400,6 +7964,21 @@ static int ixgbevf_suspend(struct pci_dev *pdev, pm_message_t __maybe_unused sta
 	return 0;
 }
 
+/**
+ * ixgbevf_suspend - Suspend the network device
+ * @pdev: Pointer to the PCI device structure
+ * @state: Unused power management message indicating the suspend state
+ *
+ * Takes the fast path of __ixgbevf_suspend(), so that resume does not have
+ * to allocate vectors and rings again.
+ *
+ * Return: 0 on success, or a negative error code if saving the PCI state fails.
+ */
+static int ixgbevf_suspend(struct pci_dev *pdev, pm_message_t __maybe_unused state)
+{
+	return __ixgbevf_suspend(pdev, true);
+}
+
 #ifdef CONFIG_PM
 /**
  * ixgbevf_resume - Resume the network device from a suspended state
@@ -5408,10 +7987,12 @@ static int ixgbevf_suspend(struct pci_dev *pdev, pm_message_t __maybe_unused sta
  * This function resumes the network device from a suspended state. It restores
  * the PCI device state, enables the device memory, and reinitializes the
  * hardware address. The function clears the disabled state of the adapter and
- * sets the PCI device as a primary bus device. It then resets the adapter and
- * initializes the interrupt scheme. If the network interface is running, the
- * function opens the device to resume network operations. Finally, it attaches
- * the network device to the system, making it available for use.
+ * sets the PCI device as a primary bus device. It then resets the adapter,
+ * which renegotiates the mailbox API and MAC address with the PF. Rings and
+ * IRQs kept by ixgbevf_suspend() are brought back up directly; the queue
+ * layout is checked against the PF while doing so, and a mismatch is handled
+ * by the usual queue reset from the service task. Finally, it attaches the
+ * network device to the system, making it available for use.
  *
  * Return: 0 on success, or a negative error code if the resume operation fails.
  */
@@ -5419,7 +8000,7 @@ static int ixgbevf_resume(struct pci_dev *pdev)
 {
 	struct net_device *netdev = pci_get_drvdata(pdev);
 	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
-	int err;
+	int err = 0;
 
 	pci_restore_state(pdev);
 	/*
@@ -5442,9 +8023,16 @@ static int ixgbevf_resume(struct pci_dev *pdev)
 	ixgbevf_reset(adapter);
 
 	rtnl_lock();
-	err = ixgbevf_init_interrupt_scheme(adapter);
-	if (!err && netif_running(netdev))
-		err = ixgbevf_open(netdev);
+	/* cleared by ixgbevf_close() if the interface went down meanwhile */
+	if (test_and_clear_bit(__IXGBEVF_SUSPENDED, &adapter->state)) {
+		ixgbevf_up(adapter);
+	} else {
+		if (!adapter->num_rx_queues)
+			err = ixgbevf_init_interrupt_scheme(adapter);
+		if (!err && netif_running(netdev))
+			err = ixgbevf_open(netdev);
+	}
+	ixgbevf_autotune_reset(adapter);
 	rtnl_unlock();
 	if (err)
 		return err;
@@ -5460,14 +8048,14 @@ static int ixgbevf_resume(struct pci_dev *pdev)
  * @pdev: Pointer to the PCI device structure
  *
  * This function performs a shutdown operation on the network device. It
- * suspends the device by calling the `ixgbevf_suspend` function with the
- * `PMSG_SUSPEND` message, which prepares the device for a safe shutdown.
- * This is typically used to ensure that the device is in a consistent state
- * before the system is powered off or rebooted.
+ * releases the interrupt scheme and ring memory through __ixgbevf_suspend(),
+ * which prepares the device for a safe shutdown. This is typically used to
+ * ensure that the device is in a consistent state before the system is
+ * powered off or rebooted.
  */
 static void ixgbevf_shutdown(struct pci_dev *pdev)
 {
-	ixgbevf_suspend(pdev, PMSG_SUSPEND);
+	__ixgbevf_suspend(pdev, false);
 }
 #endif /* USE_REBOOT_NOTIFIER */
 
@@ -5807,6 +8395,9 @@ static void ixgbevf_assign_netdev_ops(struct net_device *dev)
 {
 #ifdef HAVE_NET_DEVICE_OPS
 	dev->netdev_ops = &ixgbevf_netdev_ops;
+#if defined(HAVE_NETDEV_QUEUE_MGMT_OPS) && !defined(HAVE_NETDEV_OPS_LOCK)
+	dev->queue_mgmt_ops = &ixgbevf_queue_mgmt_ops;
+#endif
 #else /* HAVE_NET_DEVICE_OPS */
 	dev->open = ixgbevf_open;
 	dev->stop = ixgbevf_close;
@@ -6066,6 +8657,7 @@ static int __devinit ixgbevf_probe(struct pci_dev *pdev,
 		goto err_sw_init;
 	}
 	INIT_WORK(&adapter->service_task, ixgbevf_service_task);
+	INIT_WORK(&adapter->rx_mode_task, ixgbevf_rx_mode_task);
 	set_bit(__IXGBEVF_SERVICE_INITED, &adapter->state);
 	clear_bit(__IXGBEVF_SERVICE_SCHED, &adapter->state);
 
@@ -6081,6 +8673,7 @@ static int __devinit ixgbevf_probe(struct pci_dev *pdev,
 
 	pci_set_drvdata(pdev, netdev);
 	netif_carrier_off(netdev);
+	ixgbevf_dbg_adapter_init(adapter);
 
 	netif_tx_stop_all_queues(netdev);
 	ixgbevf_init_last_counter_stats(adapter);
@@ -6162,10 +8755,16 @@ static void ixgbevf_remove(struct pci_dev *pdev)
 	set_bit(__IXGBEVF_REMOVING, &adapter->state);
 	cancel_work_sync(&adapter->service_task);
 
+	ixgbevf_dbg_adapter_exit(adapter);
+
 	if (netdev->reg_state == NETREG_REGISTERED)
 		unregister_netdev(netdev);
 
+	cancel_work_sync(&adapter->rx_mode_task);
+	kfree(adapter->rx_mode_uc);
+
 	ixgbevf_clear_interrupt_scheme(adapter);
+	ixgbevf_fanout_free(adapter);
 
 	iounmap(adapter->io_addr);
 	pci_release_regions(pdev);
@@ -6203,15 +8802,24 @@ static pci_ers_result_t ixgbevf_io_error_detected(struct pci_dev *pdev,
 
 	rtnl_lock();
 	netif_device_detach(netdev);
-
-	if (netif_running(netdev))
-		ixgbevf_close_suspend(adapter);
+	cancel_work_sync(&adapter->rx_mode_task);
 
 	if (state == pci_channel_io_perm_failure) {
+		if (netif_running(netdev) ||
+		    test_and_clear_bit(__IXGBEVF_SUSPENDED, &adapter->state))
+			ixgbevf_close_suspend(adapter);
 		rtnl_unlock();
 		return PCI_ERS_RESULT_DISCONNECT;
 	}
 
+	/* keep rings, pages and IRQs, ixgbevf_io_resume() reuses them */
+	if (netif_running(netdev)) {
+		set_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
+		ixgbevf_down(adapter);
+		clear_bit(__IXGBEVF_WARM_RESTART, &adapter->state);
+		set_bit(__IXGBEVF_SUSPENDED, &adapter->state);
+	}
+
 	if (!test_and_set_bit(__IXGBEVF_DISABLED, &adapter->state))
 		pci_disable_device(pdev);
 	rtnl_unlock();
@@ -6238,6 +8846,10 @@ static pci_ers_result_t ixgbevf_io_slot_reset(struct pci_dev *pdev)
 		return PCI_ERS_RESULT_DISCONNECT;
 	}
 
+	/* the kept MSI-X vectors need their table programmed again */
+	pci_restore_state(pdev);
+	pci_save_state(pdev);
+
 	adapter->hw.hw_addr = adapter->io_addr;
 	smp_mb__before_atomic();
 	clear_bit(__IXGBEVF_DISABLED, &adapter->state);
@@ -6254,14 +8866,19 @@ static pci_ers_result_t ixgbevf_io_slot_reset(struct pci_dev *pdev)
  *
  * This callback is called when the error recovery driver tells us that
  * its OK to resume normal operation. Implementation resembles the
- * second-half of the ixgbevf_resume routine.
+ * second-half of the ixgbevf_resume routine: rings kept by
+ * ixgbevf_io_error_detected() only have their queue registers programmed
+ * again, and the rx-mode and VLAN filters are replayed to the PF.
  */
 static void ixgbevf_io_resume(struct pci_dev *pdev)
 {
 	struct net_device *netdev = pci_get_drvdata(pdev);
+	struct ixgbevf_adapter *adapter = netdev_priv(netdev);
 
 	rtnl_lock();
-	if (netif_running(netdev))
+	if (test_and_clear_bit(__IXGBEVF_SUSPENDED, &adapter->state))
+		ixgbevf_up(adapter);
+	else if (netif_running(netdev))
 		ixgbevf_open(netdev);
 
 	netif_device_attach(netdev);
@@ -6357,11 +8974,35 @@ static struct pci_driver ixgbevf_driver = {
 	.shutdown = ixgbevf_shutdown,
 #endif
 	.err_handler = &ixgbevf_err_handler,
+#ifdef HAVE_DRIVER_PROBE_TYPE
+	/* each VF resets and negotiates with the PF on its own, so a VM
+	 * with several of them need not bring them up one after another
+	 */
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
 #ifdef HAVE_RHEL7_PCI_RESET_NOTIFY
 	.pci_driver_rh = &ixgbevf_driver_rh,
 #endif
 };
 
+/**
+ * ixgbevf_check_layout - build time checks of the datapath structures
+ *
+ * Keeps the per-packet ring fields in the first cache line and the Tx and
+ * Rx buffer metadata at 40 and 24 bytes, so later edits cannot spread the
+ * hot path over more cache lines.
+ **/
+static void __init ixgbevf_check_layout(void)
+{
+#if defined(CONFIG_64BIT) && (L1_CACHE_BYTES >= 64)
+	BUILD_BUG_ON(offsetof(struct ixgbevf_ring, next_to_alloc) +
+		     sizeof(u16) > 64);
+	BUILD_BUG_ON(offsetof(struct ixgbevf_ring, next) != 64);
+	BUILD_BUG_ON(sizeof(struct ixgbevf_tx_buffer) > 40);
+	BUILD_BUG_ON(sizeof(struct ixgbevf_rx_buffer) > 24);
+#endif
+}
+
 /**
  * ixgbevf_init_module - Driver Registration Routine
  *
@@ -6371,12 +9012,19 @@ static struct pci_driver ixgbevf_driver = {
 static int __init ixgbevf_init_module(void)
 {
 	int ret;
+
+	ixgbevf_check_layout();
 	pr_info("ixgbevf: %s - version %s\n", ixgbevf_driver_string,
 		ixgbevf_driver_version);
 
 	pr_info("ixgbevf: %s\n", ixgbevf_copyright);
 
+	ixgbevf_dbg_init();
+
 	ret = pci_register_driver(&ixgbevf_driver);
+	if (ret)
+		ixgbevf_dbg_exit();
+
 	return ret;
 }
 
@@ -6391,6 +9039,7 @@ module_init(ixgbevf_init_module);
 static void __exit ixgbevf_exit_module(void)
 {
 	pci_unregister_driver(&ixgbevf_driver);
+	ixgbevf_dbg_exit();
 }
 
 module_exit(ixgbevf_exit_module);
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 1999 - 2026 Intel Corporation. */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ixgbevf
+
+#if !defined(_IXGBEVF_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _IXGBEVF_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(ixgbevf_mbx_template,
+
+	TP_PROTO(struct ixgbe_hw *hw, u32 *msg, u16 size, s32 ret_val),
+
+	TP_ARGS(hw, msg, size, ret_val),
+
+	TP_STRUCT__entry(
+		__field(void *, hw)
+		__field(u32, msg0)
+		__field(u32, msg1)
+		__field(u16, size)
+		__field(s32, ret_val)
+	),
+
+	TP_fast_assign(
+		__entry->hw = hw;
+		__entry->msg0 = msg[0];
+		__entry->msg1 = size > 1 ? msg[1] : 0;
+		__entry->size = size;
+		__entry->ret_val = ret_val;
+	),
+
+	TP_printk("hw %p msg %08x %08x size %u ret %d",
+		  __entry->hw, __entry->msg0, __entry->msg1, __entry->size,
+		  __entry->ret_val)
+);
+
+/* request handed to the mailbox, ret_val covers the ack wait */
+DEFINE_EVENT(ixgbevf_mbx_template, ixgbevf_mbx_write,
+	TP_PROTO(struct ixgbe_hw *hw, u32 *msg, u16 size, s32 ret_val),
+	TP_ARGS(hw, msg, size, ret_val));
+
+/* reply polled from the PF, msg is stale when ret_val is set */
+DEFINE_EVENT(ixgbevf_mbx_template, ixgbevf_mbx_poll,
+	TP_PROTO(struct ixgbe_hw *hw, u32 *msg, u16 size, s32 ret_val),
+	TP_ARGS(hw, msg, size, ret_val));
+
+#endif /* _IXGBEVF_TRACE_H_ */
+
+/* must stay outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ixgbevf_trace
+#include <trace/define_trace.h>
@@ -105,6 +105,7 @@ function gen-device() {
 	dph='include/linux/dev_printk.h'
 	gen NEED_BUS_FIND_DEVICE_CONST_DATA if fun bus_find_device lacks 'const void \\*data' in "$dh"
 	gen NEED_DEV_LEVEL_ONCE if macro dev_level_once absent in "$dh" "$dph"
+	gen HAVE_DRIVER_PROBE_TYPE if enum probe_type in "$dh" include/linux/device/driver.h
 }
 
 function gen-devlink() {
@@ -514,10 +515,12 @@ function gen-other() {
 	gen NEED_FIND_NEXT_BIT_WRAP if fun find_next_bit_wrap absent in include/linux/find.h
 	gen HAVE_FILE_IN_SEQ_FILE if struct seq_file matches 'struct file' in include/linux/fs.h
 	gen NEED_FS_FILE_DENTRY if fun file_dentry absent in include/linux/fs.h
+	gen NEED_HRTIMER_SETUP if fun hrtimer_setup absent in include/linux/hrtimer.h
 	gen HAVE_HWMON_DEVICE_REGISTER_WITH_INFO if fun hwmon_device_register_with_info in include/linux/hwmon.h
 	gen NEED_HWMON_CHANNEL_INFO if macro HWMON_CHANNEL_INFO absent in include/linux/hwmon.h
 	gen NEED_ETH_TYPE_VLAN if fun eth_type_vlan absent in include/linux/if_vlan.h
 	gen HAVE_IOMMU_DEV_FEAT_AUX if enum iommu_dev_features matches IOMMU_DEV_FEAT_AUX in include/linux/iommu.h
+	gen NEED_IRQ_UPDATE_AFFINITY_HINT if fun irq_update_affinity_hint absent in include/linux/interrupt.h
 	gen NEED_READ_POLL_TIMEOUT if macro read_poll_timeout absent in include/linux/iopoll.h
 	gen NEED_READ_POLL_TIMEOUT_ATOMIC if macro read_poll_timeout_atomic absent in include/linux/iopoll.h
 	gen NEED_DEFINE_STATIC_KEY_FALSE if macro DEFINE_STATIC_KEY_FALSE absent in include/linux/jump_label.h
@@ -566,6 +569,7 @@ function gen-other() {
 	gen NEED_NAPI_BUILD_SKB if fun napi_build_skb absent in include/linux/skbuff.h
 	gen NEED_SKB_FRAG_OFF if fun skb_frag_off absent in include/linux/skbuff.h
 	gen NEED_SKB_FRAG_OFF_ADD if fun skb_frag_off_add absent in include/linux/skbuff.h
+	gen NEED_CALL_SINGLE_DATA_T if typedef call_single_data_t absent in include/linux/smp.h
 	gen NEED_SYSFS_MATCH_STRING if macro sysfs_match_string absent in include/linux/string.h
 	gen HAVE_STRING_CHOICES_H if fun str_enabled_disabled in include/linux/string_choices.h
 	gen NEED_STR_ENABLED_DISABLED if fun str_enabled_disabled absent in include/linux/string_choices.h include/linux/string_helpers.h
@@ -583,6 +587,8 @@ function gen-other() {
 	gen HAVE_XARRAY_API if macro DEFINE_XARRAY in include/linux/xarray.h
 	gen HAVE_TC_FLOWER_ENC if enum flow_dissector_key_id matches FLOW_DISSECTOR_KEY_ENC_CONTROL in include/net/flow_dissector.h
 	gen HAVE_TC_FLOWER_VLAN_IN_TAGS if enum flow_dissector_key_id matches FLOW_DISSECTOR_KEY_VLANID in include/net/flow_dissector.h
+	gen HAVE_NETDEV_OPS_LOCK if fun netdev_need_ops_lock in include/net/netdev_lock.h
+	gen HAVE_NETDEV_QUEUE_MGMT_OPS if struct netdev_queue_mgmt_ops in include/net/netdev_queues.h
 	gen HAVE_NET_RPS_H if macro RPS_NO_FILTER in include/net/rps.h
 	gen HAVE_UDP_TUNNEL_NIC_INFO_MAY_SLEEP if enum udp_tunnel_nic_info_flags matches UDP_TUNNEL_NIC_INFO_MAY_SLEEP in include/net/udp_tunnel.h
 	gen NEED_XDP_CONVERT_BUFF_TO_FRAME if fun xdp_convert_buff_to_frame absent in include/net/xdp.h
@@ -3685,6 +3685,66 @@ void resource_set_range(struct resource *res, resource_size_t start,
 			resource_size_t size);
 #endif /* !HAVE_RESOURCE_SET_RANGE */
 
+/* NEED_IRQ_UPDATE_AFFINITY_HINT
+ *
+ * irq_update_affinity_hint() and irq_set_affinity_and_hint() were introduced
+ * by upstream commit 65c7cdedeb30 ("genirq: Provide new interfaces for
+ * affinity hints"). Before that irq_set_affinity_hint() both published the
+ * hint and applied it, so it can only stand in for irq_set_affinity_and_hint().
+ * Old kernels store the hint as a pointer to the caller's mask, so a hint
+ * published once follows later changes to that mask without being applied
+ * again. The irq_update_affinity_hint() fallback therefore only clears the
+ * hint and leaves a non-NULL one alone, so it never overrides an affinity
+ * the user has set. The cost is that a cleared hint is not published again
+ * on these kernels.
+ */
+#ifdef NEED_IRQ_UPDATE_AFFINITY_HINT
+#include <linux/interrupt.h>
+static inline int
+irq_update_affinity_hint(unsigned int irq, const struct cpumask *m)
+{
+	if (!m)
+		return irq_set_affinity_hint(irq, NULL);
+
+	return 0;
+}
+
+static inline int
+irq_set_affinity_and_hint(unsigned int irq, const struct cpumask *m)
+{
+	return irq_set_affinity_hint(irq, m);
+}
+#endif /* NEED_IRQ_UPDATE_AFFINITY_HINT */
+
+/* NEED_HRTIMER_SETUP
+ *
+ * hrtimer_setup() was introduced by upstream commit 908a1d775422 ("hrtimers:
+ * Introduce hrtimer_setup() to replace hrtimer_init()") and hrtimer_init()
+ * was later removed, so wrap the old interface for older kernels.
+ */
+#ifdef NEED_HRTIMER_SETUP
+#include <linux/hrtimer.h>
+static inline void
+hrtimer_setup(struct hrtimer *timer,
+	      enum hrtimer_restart (*function)(struct hrtimer *),
+	      clockid_t clock_id, enum hrtimer_mode mode)
+{
+	hrtimer_init(timer, clock_id, mode);
+	timer->function = function;
+}
+#endif /* NEED_HRTIMER_SETUP */
+
+/* NEED_CALL_SINGLE_DATA_T
+ *
+ * call_single_data_t was introduced by upstream commit 966a967116e6 ("smp:
+ * Avoid using two cache lines for struct call_single_data"), older kernels
+ * only have struct call_single_data with the same func and info members.
+ */
+#ifdef NEED_CALL_SINGLE_DATA_T
+#include <linux/smp.h>
+typedef struct call_single_data call_single_data_t;
+#endif /* NEED_CALL_SINGLE_DATA_T */
+
 #ifdef NEED___COUNTED_BY
 #ifdef HAVE_CONFIG_CC_HAS_COUNTED_BY
 # define __counted_by(member)		__attribute__((__counted_by__(member)))